@@ -0,0 +1,85 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <cstdint>
+#include <vector>
+
+// Chunks are CHUNK_SIZE x CHUNK_SIZE columns of terrain, CHUNK_HEIGHT blocks tall
+const int CHUNK_SIZE = 32;
+const int CHUNK_HEIGHT = 32;
+
+// Terrain below this height is sand, above it grass
+const int SAND_LEVEL = 7;
+
+// Air below this height is filled with water
+const int WATER_LEVEL = 7;
+
+enum BlockType : uint8_t {
+    BLOCK_AIR = 0,
+    BLOCK_SAND,
+    BLOCK_GRASS,
+    BLOCK_WOOD,
+    BLOCK_LEAVES,
+    BLOCK_STONE,
+    BLOCK_WATER,
+    BLOCK_GLASS,
+    BLOCK_TYPE_COUNT
+};
+
+// Water and glass are translucent: they are meshed and drawn apart from everything else,
+// and neither hide nor shade the faces behind them
+inline bool isTranslucent(uint8_t block) {
+    return block >= BLOCK_WATER;
+}
+
+inline bool isOpaque(uint8_t block) {
+    return block != BLOCK_AIR && !isTranslucent(block);
+}
+
+enum DecorationType : uint8_t {
+    DECORATION_TREE = 0,
+    DECORATION_ROCK,
+    DECORATION_RUIN
+};
+
+// A decoration candidate produced by Poisson-disk sampling, in world column coordinates
+struct Decoration {
+    int x;
+    int z;
+    DecorationType type;
+    uint32_t priority; // Resolves overlaps with candidates of neighbouring chunks
+};
+
+// Side of a cell in the per-chunk decoration spatial hash, in columns. It must not exceed
+// DECORATION_SPACING / sqrt(2) so a cell never holds more than one candidate.
+const int DECORATION_CELL = 4;
+const int DECORATION_GRID = CHUNK_SIZE / DECORATION_CELL;
+
+struct Chunk {
+    int chunkX = 0;
+    int chunkZ = 0;
+
+    // Columns per height sample: 0 until generated, COARSE_STEP for the quick low-detail
+    // pass, 1 once refined. Decorations are only added at full detail.
+    int detail = 0;
+    bool decorated = false;
+
+    // Set whenever the blocks of this chunk or of a neighbour change, so the mesh must be rebuilt
+    bool meshDirty = true;
+
+    // Set along with meshDirty when the change was a player edit; such meshes are rebuilt
+    // ahead of streaming and shown in the same frame
+    bool editDirty = false;
+
+    // Column heights in blocks, indexed [x][z] in chunk-local coordinates
+    int heights[CHUNK_SIZE][CHUNK_SIZE] = {};
+
+    // Block types indexed [x][y][z]
+    uint8_t blocks[CHUNK_SIZE][CHUNK_HEIGHT][CHUNK_SIZE] = {};
+
+    // Decoration candidates and their spatial hash (index into the vector, or -1)
+    std::vector<Decoration> decorations;
+    int16_t decorationGrid[DECORATION_GRID][DECORATION_GRID];
+};
+
+#endif
@@ -0,0 +1,274 @@
+#ifndef CHUNK_RENDERER_H
+#define CHUNK_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "shader.h"
+#include "world.h"
+#include "thread_pool.h"
+#include "bounded_queue.h"
+#include "mesher.h"
+#include "quad_arena.h"
+#include "stream_buffer.h"
+
+// Texture unit the face records are bound to while drawing
+const int FACE_TEXTURE_UNIT = 2;
+
+// Texture unit the per-chunk origins and scales are bound to while drawing
+const int CHUNK_TRANSFORM_TEXTURE_UNIT = 4;
+
+// Upper bound on the mesh data uploaded per frame. At least one mesh is uploaded every
+// frame however big it is, so large meshes still make progress.
+const size_t UPLOAD_BUDGET_BYTES = 512 * 1024;
+
+// Stream buffer space per frame: the upload budget with room to spare, plus draw commands
+// and transforms. Uploads that don't fit, like a burst of edits, go straight to the arena.
+const size_t STREAM_FRAME_BYTES = 2 * 1024 * 1024;
+
+// Live blocks each arena may move per frame while compacting
+const int ARENA_MOVES_PER_FRAME = 4;
+
+// Largest error, in pixels on screen, a chunk's level of detail may introduce
+const float LOD_ERROR_PIXELS = 6.0f;
+
+// Fraction of a level's distance the camera must pass it by before a chunk switches level,
+// so a camera sitting on a boundary doesn't remesh the chunks there back and forth
+const float LOD_HYSTERESIS = 0.15f;
+
+// Packed quad records held by one of the renderer's arenas
+struct MeshPart {
+    int allocation = -1; // Arena handle, -1 when the part is empty
+    int quadCount = 0;
+};
+
+// Layout glMultiDrawElementsIndirect reads its commands in
+struct DrawElementsCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+// GPU copy of one chunk's mesh. Translucent faces are kept apart, to be drawn after every
+// opaque one and re-sorted without touching the rest.
+struct ChunkMesh {
+    MeshPart opaque;
+    MeshPart translucent;
+    int lod = 0;
+
+    // The last skirtQuads opaque quads are skirts, drawn only when a neighbour is at
+    // another level of detail
+    int skirtQuads = 0;
+};
+
+// Input and output of one worker job: the chunk's padded snapshot (or, at a coarser level
+// of detail, the blocks it is downsampled from) and the quads built from it, or
+// translucent quads to re-sort, or the chunk draw order
+struct MeshBuffer {
+    PaddedChunk padded;
+    ChunkSnapshot snapshot;
+    std::vector<uint32_t> faces;
+    std::vector<uint32_t> translucent;
+    std::vector<int> order;
+    int skirtQuads = 0;
+};
+
+// A chunk's mesh as built by a worker, waiting to be uploaded by the render thread. Sort
+// jobs hand back the same thing, with chunkIndex -1 for the chunk draw order.
+struct MeshResult {
+    int chunkIndex = 0;
+    uint32_t generation = 0;
+    uint32_t sortPass = 0; // Camera cell the translucent faces are sorted for
+    int lod = 0;
+    MeshBuffer* buffer = nullptr;
+};
+
+// Owns the meshes of every chunk in a world and draws the ones in range. Meshes are built
+// on worker threads from padded snapshots of the chunks, and handed back through a
+// lock-free queue; all GL calls stay on the thread that calls update() and draw().
+// Every mesh lives in one of two shared arenas, opaque and translucent, so each pass is
+// a single multi-draw over the chunks in range.
+// Translucent faces are sorted back to front on the workers too, again whenever the camera
+// moves into another block, along with the far to near order of the chunks.
+class ChunkRenderer {
+public:
+    // blockScale is the world-space size of one block; the world is centred on the origin
+    ChunkRenderer(World& world, ThreadPool& pool, float blockScale);
+    ~ChunkRenderer();
+
+    ChunkRenderer(const ChunkRenderer&) = delete;
+    ChunkRenderer& operator=(const ChunkRenderer&) = delete;
+
+    // Start rebuilding the meshes of chunks flagged as dirty, and upload finished meshes
+    // within the per-frame byte budget. Chunks dirtied by edits are meshed first and
+    // uploaded before this returns. Also starts and collects translucent re-sorts when the
+    // camera has changed block.
+    void update(glm::vec3 cameraPos);
+
+    // Set the vertical field of view (radians) and viewport height used to pick each
+    // chunk's level of detail; call before update() whenever they change
+    void setProjection(float fovY, int viewportHeight);
+
+    // Distance from the camera beyond which chunks are drawn coarser than `lod`
+    float lodDistance(int lod) const;
+
+    // Draw the opaque faces of every chunk whose nearest point is within maxDistance of the
+    // camera but beyond minDistance, nearest chunk first. The shader must already be in use; its "faces" sampler
+    // is set to FACE_TEXTURE_UNIT and "chunkTransforms" to CHUNK_TRANSFORM_TEXTURE_UNIT.
+    void draw(const Shader& shader, glm::vec3 cameraPos, float maxDistance, float minDistance = -1.0f);
+
+    // Draw the translucent faces of the chunks in range, farthest chunk first, after
+    // everything opaque. Blending and depth writes are up to the caller.
+    void drawTranslucent(const Shader& shader, glm::vec3 cameraPos, float maxDistance, float minDistance = -1.0f);
+
+    // Occupancy and fragmentation of the arena holding opaque or translucent faces
+    ArenaStats getArenaStats(bool translucent) const;
+
+    const StreamBuffer& getStreamBuffer() const { return stream; }
+    unsigned int getVertexArray() const { return VAO; }
+
+    // Transform from chunk-local corner positions to world space. At level of detail lod
+    // a position unit is a cell of 2^lod blocks.
+    glm::mat4 chunkModel(int chunkX, int chunkZ, int lod = 0) const;
+
+private:
+    // Block until no mesh or sort job is running, dropping any mesh not yet uploaded
+    void waitForMeshing();
+
+    // Mesh the chunks dirtied by edits on the pool's urgent lane, ahead of any queued
+    // streaming, and upload them regardless of the budget
+    void meshEdits();
+
+    // Send chunks dirtied by streaming, or whose level of detail has changed, to the workers
+    void dispatch();
+
+    // Take a buffer and snapshot a chunk into it, for meshing at its requested level of
+    // detail. Downsampling is left to the worker.
+    MeshResult startJob(int chunkIndex, const Chunk& chunk);
+
+    // Build the meshes of a started job; runs on a worker
+    void buildMesh(MeshResult& job, glm::vec3 eye) const;
+
+    // Upload a finished mesh unless it has been superseded, and recycle its buffer.
+    // Returns the bytes uploaded.
+    size_t uploadResult(const MeshResult& result);
+
+    // Start re-sorting the translucent faces of chunks sorted for an older camera cell, and
+    // the chunk order, then upload the sorts that have finished
+    void updateSorting();
+
+    // Camera position in the cell units of a chunk at a level of detail, as
+    // sortBackToFront takes it
+    glm::vec3 chunkEye(int chunkIndex, int lod, glm::vec3 cameraPos) const;
+
+    // Distance from the camera to the nearest point of a chunk
+    float chunkDistance(int chunkX, int chunkZ, glm::vec3 cameraPos) const;
+
+    // Coarsest level of detail whose error stays within LOD_ERROR_PIXELS for a chunk,
+    // keeping the level last requested while the distance is within LOD_HYSTERESIS of it
+    int selectLod(int chunkX, int chunkZ, glm::vec3 cameraPos) const;
+
+    // Whether any neighbour of a chunk is drawn at another level of detail
+    bool needsSkirts(int chunkX, int chunkZ) const;
+
+    // Write faces into a fresh allocation and free the part's old one, so draws only ever
+    // see a complete mesh
+    void upload(MeshPart& part, QuadArena& arena, const std::vector<uint32_t>& faces);
+
+    // Queue a draw of the first quadCount quads of a part for the next submit()
+    void addCommand(const MeshPart& part, const QuadArena& arena, int quadCount);
+
+    // Draw every queued command from one arena in a single call
+    void submit(const Shader& shader, const QuadArena& arena);
+
+    // Upload the origin and scale of every chunk at its current level of detail
+    void uploadTransforms();
+
+    // Write records into an arena allocation through the stream buffer
+    void writeQuads(QuadArena& arena, int allocation, const uint32_t* records, int quads);
+
+    // Make the shared quad index buffer large enough for `quads` faces
+    void reserveQuadIndices(int quads);
+
+    MeshBuffer* acquireBuffer();
+    void releaseBuffer(MeshBuffer* buffer);
+
+    World& world;
+    ThreadPool& pool;
+    float blockScale;
+
+    std::vector<ChunkMesh> meshes;
+    std::unique_ptr<QuadArena> opaqueArena;
+    std::unique_ptr<QuadArena> translucentArena;
+
+    // Per-frame staging for everything uploaded after startup
+    StreamBuffer stream;
+
+    // Latest generation requested per chunk; older results are dropped
+    std::vector<uint32_t> generations;
+
+    // Level of detail each chunk should be drawn at for the current camera, and the one
+    // its latest mesh job was started with
+    std::vector<int> wantedLods;
+    std::vector<int> requestedLods;
+    float pixelsPerUnit = 0.0f; // Screen pixels per world unit at distance 1
+
+    // Mesh buffers are recycled between jobs instead of reallocated. Only the render
+    // thread touches the pool; a worker owns a buffer from dispatch until its result is
+    // popped.
+    std::vector<std::unique_ptr<MeshBuffer>> bufferStorage;
+    std::vector<MeshBuffer*> freeBuffers;
+
+    BoundedQueue<MeshResult> finished;
+    std::deque<MeshResult> pendingUploads;
+    std::atomic<int> jobsInFlight{ 0 };
+    std::vector<MeshResult> editJobs;
+    std::vector<glm::vec3> editEyes;
+
+    // Translucent sorting. Each time the camera enters another block the sort pass goes up;
+    // a chunk whose faces were sorted for an older pass gets a sort job, at most one at a
+    // time. The render thread keeps its own copy of the faces to hand to those jobs.
+    BoundedQueue<MeshResult> sorted;
+    std::atomic<int> sortJobsInFlight{ 0 };
+    glm::ivec3 sortCell{ 0, -1000000, 0 };
+    glm::vec3 sortEye{ 0.0f };
+    uint32_t sortPass = 0;
+    std::vector<std::vector<uint32_t>> translucentFaces;
+    std::vector<uint32_t> uploadedGenerations;
+    std::vector<uint32_t> sortedPasses;
+    std::vector<bool> sorting;
+    uint32_t orderPass = 0;
+    bool orderSorting = false;
+
+    // Chunk indices, farthest from the camera first; opaque draws walk it backwards
+    std::vector<int> drawOrder;
+
+    // Attribute-less VAO holding the shared quad index buffer
+    unsigned int VAO = 0;
+    unsigned int quadEBO = 0;
+    int quadCapacity = 0;
+
+    // World-space origin and scale of each chunk, one RGBA32F texel apiece, found by the
+    // chunk slot in its quad records
+    unsigned int transformBuffer = 0;
+    unsigned int transformTexture = 0;
+    bool transformsDirty = true;
+
+    // Draws of the pass being built. Commands go through the stream buffer as indirect
+    // draws where the context has them, and are unpacked into base-vertex multi-draw
+    // arrays otherwise. indirectBuffer takes the commands when the stream buffer is full.
+    bool indirectDraws = false;
+    unsigned int indirectBuffer = 0;
+    std::vector<DrawElementsCommand> commands;
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void*> drawOffsets;
+    std::vector<GLint> drawBaseVertices;
+};
+
+#endif
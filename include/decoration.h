@@ -0,0 +1,23 @@
+#ifndef DECORATION_H
+#define DECORATION_H
+
+#include <cstdint>
+#include "chunk.h"
+
+class World;
+
+// Minimum distance between two decorations, in columns
+const float DECORATION_SPACING = 6.0f;
+
+// Deterministic Poisson-disk sampling of decoration candidates inside one chunk.
+// Depends only on the world seed and chunk coordinates, so it can run on any thread in any order.
+void placeDecorationCandidates(Chunk& chunk, uint64_t seed);
+
+// Resolve candidates against the neighbouring chunks' spatial hashes and stamp the
+// surviving trees, rocks and ruins into this chunk's blocks. Decorations rooted in a
+// neighbour that overhang this chunk are stamped here too. Only writes to `chunk`, and
+// only reads candidates, heights and the ground blocks under them from the others, so
+// chunks can be decorated in parallel once every chunk has its terrain and candidates.
+void decorateChunk(Chunk& chunk, const World& world);
+
+#endif
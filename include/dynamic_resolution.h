@@ -0,0 +1,55 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+// Range of the render scale, as a fraction of the window size along each axis
+const float MIN_RENDER_SCALE = 0.5f;
+const float MAX_RENDER_SCALE = 1.0f;
+// Frames between scale changes, so the last change shows in the measured times first
+const int RENDER_SCALE_INTERVAL = 15;
+// Largest change of the scale in one step
+const float RENDER_SCALE_STEP = 0.1f;
+// Weight of the newest frame in the running average of frame times
+const float FRAME_TIME_SMOOTHING = 0.1f;
+
+// The scene drawn offscreen at a fraction of the window resolution, scaled to hold a frame
+// time budget and stretched onto the default framebuffer at the end of the frame. The
+// targets are allocated at full size once; lower scales draw into a corner of them.
+class DynamicResolution {
+public:
+    // width and height are the window size; targetFrameTime is in seconds
+    DynamicResolution(int width, int height, float targetFrameTime);
+    ~DynamicResolution();
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    // Add the measured time of the last frame. Every RENDER_SCALE_INTERVAL frames the scale
+    // moves toward the one that would fit the budget.
+    void update(float frameTime);
+
+    // Bind the offscreen target, with the viewport covering the scaled size
+    void bind() const;
+
+    // Stretch what was drawn onto the default framebuffer, and leave that bound
+    void present() const;
+
+    float getScale() const { return scale; }
+    int getWidth() const;
+    int getHeight() const;
+    float getAverageFrameTime() const { return averageFrameTime; }
+    float getTargetFrameTime() const { return targetFrameTime; }
+
+private:
+    int width;
+    int height;
+    float targetFrameTime;
+    float scale = MAX_RENDER_SCALE;
+    float averageFrameTime = 0.0f;
+    int framesSinceChange = 0;
+
+    unsigned int FBO = 0;
+    unsigned int colorBuffer = 0;
+    unsigned int depthBuffer = 0;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glm/glm.hpp>
+
+// Uniform buffer binding point of the FrameUniforms block
+const unsigned int FRAME_UNIFORMS_BINDING = 0;
+
+// Values shared by every shader for a whole frame, written to one uniform buffer once a
+// frame. Laid out as the std140 block FrameUniforms declared in the shaders; each vec3 is
+// padded to 16 bytes, except that renderDistance fills the last one's padding.
+struct FrameUniforms {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 lightSpaceMatrix;
+    glm::vec3 viewPos;
+    float padding0;
+    glm::vec3 lightPos;
+    float padding1;
+    glm::vec3 sunPosition;
+    float padding2;
+    glm::vec3 fogColor;
+    float renderDistance;
+};
+
+static_assert(sizeof(FrameUniforms) == 256, "FrameUniforms must match the std140 layout");
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// Texture units the cache tracks; binds to higher units always go through
+const int GL_STATE_TEXTURE_UNITS = 8;
+
+// Binds and fixed-function state calls of one frame, and how many were skipped as
+// redundant
+struct GLStateCounts {
+    int issued = 0;
+    int elided = 0;
+};
+
+// Shadow copy of the GL binding and render state, so calls that wouldn't change anything
+// are skipped. Runtime code binds through it instead of calling GL directly, and leaves
+// things bound instead of restoring 0, since the next bind checks the cache anyway.
+// Anything changed behind its back must go through invalidate(); everything starts
+// unknown, so the first call for each piece of state is always issued.
+class GLState {
+public:
+    GLState() { invalidate(); }
+
+    void useProgram(unsigned int program);
+    void bindVertexArray(unsigned int vertexArray);
+    // GL_ARRAY_BUFFER, GL_TEXTURE_BUFFER, GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER,
+    // GL_COPY_WRITE_BUFFER or GL_DRAW_INDIRECT_BUFFER
+    void bindBuffer(GLenum target, unsigned int buffer);
+    // Binds an indexed uniform buffer, which also sets the GL_UNIFORM_BUFFER binding
+    void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+    // GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP or GL_TEXTURE_BUFFER on a
+    // unit, switching the active unit only if needed
+    void bindTexture(int unit, GLenum target, unsigned int texture);
+    void bindFramebuffer(unsigned int framebuffer);
+    void viewport(int x, int y, int width, int height);
+
+    // GL_BLEND, GL_DEPTH_TEST or GL_CULL_FACE
+    void setEnabled(GLenum capability, bool enabled);
+    void depthMask(bool write);
+    void depthFunc(GLenum func);
+    void blendFunc(GLenum source, GLenum destination) { blendFuncSeparate(source, destination, source, destination); }
+    void blendFuncSeparate(GLenum sourceRGB, GLenum destinationRGB, GLenum sourceAlpha, GLenum destinationAlpha);
+
+    // Delete objects and forget any binding of them, since GL may hand out the same
+    // names again
+    void deleteBuffer(unsigned int buffer);
+    void deleteTexture(unsigned int texture);
+
+    // Forget everything, after GL state has been changed directly
+    void invalidate();
+
+    // Counts of the frame just finished; starts counting the next one
+    void endFrame();
+    const GLStateCounts& getLastFrame() const { return lastFrame; }
+
+private:
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+    static const int BUFFER_TARGETS = 6;
+    static const int TEXTURE_TARGETS = 4;
+    static const int CAPABILITIES = 3;
+
+    static int bufferSlot(GLenum target);
+    static int textureSlot(GLenum target);
+    static int capabilitySlot(GLenum capability);
+
+    // Count a call, and report whether it needs issuing
+    bool change(unsigned int& cached, unsigned int value);
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int buffers[BUFFER_TARGETS];
+    unsigned int textures[GL_STATE_TEXTURE_UNITS][TEXTURE_TARGETS];
+    unsigned int activeUnit;
+    unsigned int framebuffer;
+    unsigned int viewportRect[4];
+    unsigned int capabilities[CAPABILITIES];
+    unsigned int depthWrite;
+    unsigned int depthTest;
+    unsigned int blend[4];
+
+    GLStateCounts counts;
+    GLStateCounts lastFrame;
+};
+
+// The state cache of the one GL context
+GLState& glState();
+
+#endif
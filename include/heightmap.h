@@ -0,0 +1,99 @@
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "terrain.h"
+
+// Read-only memory mapping of a whole file. Pages are only read from disk when touched,
+// so huge files cost address space rather than memory.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return bytes != nullptr; }
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+// Most image texels averaged per axis for one height; footprints wider than this are
+// covered by bilinear taps, each the mean of a 2x2 texel block
+const int MAX_FILTER_TAPS = 4;
+
+// Where the world sits on a heightmap
+struct HeightmapPlacement {
+    // Image texels per world column along each axis. 1 maps the image at its native
+    // resolution; above 1 it is box filtered down, below 1 bilinearly stretched.
+    float texelsPerColumn = 1.0f;
+    // Centre the world on the image, or put the corner of column (0, 0) at texel
+    // (originX, originZ)
+    bool centred = true;
+    float originX = 0.0f;
+    float originZ = 0.0f;
+};
+
+// Heights imported from an elevation image, read at a given scale and offset, so a DEM
+// far larger than the world contributes only the window under it.
+// Supported formats:
+//   .raw/.r16  square 16-bit little-endian samples (size inferred from the file length)
+//   .pgm       binary (P5) 8- or 16-bit greymap
+//   .png       8- or 16-bit, decoded into memory since PNG data is compressed
+// Raw and PGM pixels stay memory-mapped and each chunk only reads the rows it covers, so
+// pages come in as chunks are generated.
+class HeightmapSource : public HeightSource {
+public:
+    HeightmapSource(const std::string& path, int worldSizeX, int worldSizeZ, const HeightmapPlacement& placement = HeightmapPlacement());
+
+    bool isValid() const { return width > 0 && height > 0; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // Slopes are central differences of the sampled heights
+    void sampleHeights(int x0, int z0, int width, int depth, int* out, float* slopes) const override;
+    float sampleCoarseHeight(int x, int z, int step) const override;
+
+private:
+    bool openRaw();
+    bool openPgm();
+    bool openPng(const std::string& path);
+
+    // Pixel value scaled to [0, 1]; coordinates are clamped to the image
+    float pixel(int px, int py) const;
+
+    // Bilinearly interpolated value at image position (u, v), in texel units with texel
+    // centres on whole numbers
+    float bilinear(float u, float v) const;
+
+    // Value of the square footprint `columns` world columns wide centred on column (x, z),
+    // in [0, 1]: box filtered when it spans several texels, bilinear otherwise
+    float resample(int x, int z, int columns) const;
+
+    MappedFile file;
+    const unsigned char* pixels = nullptr;
+    std::vector<uint16_t> decoded;
+    int width = 0;
+    int height = 0;
+    int bytesPerSample = 2;
+    int sourceBits = 16; // Sample depth in the file; decoded PNGs are widened to 16 bits
+    bool bigEndian = false;
+    float maxValue = 65535.0f;
+    int worldSizeX;
+    int worldSizeZ;
+    HeightmapPlacement placement;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef HORIZON_IMPOSTOR_H
+#define HORIZON_IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <functional>
+#include "shader.h"
+
+// Texture unit the impostor cubemap is bound to while drawing
+const int HORIZON_TEXTURE_UNIT = 3;
+
+// Distance the camera may move, and angle the sun may turn, before the impostor is redrawn
+const float HORIZON_REFRESH_DISTANCE = 8.0f;
+const float HORIZON_REFRESH_ANGLE = glm::radians(1.0f);
+
+// Far terrain rendered into a cubemap around the camera now and then, and drawn every
+// frame as a background layer behind the near terrain. Texels nothing was drawn into are
+// left transparent, so the sky shows through.
+// A refresh draws one face a frame into a second cubemap, which is swapped in once all six
+// are done, so no single frame pays for more than one face.
+class HorizonImpostor {
+public:
+    // resolution is the side of each cubemap face in texels
+    explicit HorizonImpostor(int resolution);
+    ~HorizonImpostor();
+
+    HorizonImpostor(const HorizonImpostor&) = delete;
+    HorizonImpostor& operator=(const HorizonImpostor&) = delete;
+
+    // Whether a refresh is under way, or the camera or the sun have moved enough since the
+    // last one
+    bool needsRefresh(glm::vec3 cameraPos, float sunAngle) const;
+
+    // Draw the next face of the refresh under way, or start one from cameraPos. drawScene
+    // is called with the position the refresh started from and the face's view and
+    // projection, and should draw only the terrain beyond the near range. The first refresh
+    // draws all six faces at once, as there is nothing to show until it is done.
+    // Leaves the default framebuffer bound and the clear colour as it was; the viewport is
+    // up to the caller.
+    void refresh(glm::vec3 cameraPos, float sunAngle, float farPlane,
+        const std::function<void(glm::vec3 eye, const glm::mat4& view, const glm::mat4& projection)>& drawScene);
+
+    // Draw the cubemap behind everything, where nothing nearer has been drawn
+    void draw(Shader& shader, const glm::mat4& view, const glm::mat4& projection);
+
+    unsigned int getTexture() const { return cubemaps[front]; }
+    unsigned int getVertexArray() const { return cubeVAO; }
+
+private:
+    int resolution;
+    bool captured = false;
+    glm::vec3 capturePos{ 0.0f };
+    float captureSunAngle = 0.0f;
+
+    // Refresh under way into the back cubemap: the next face to draw, and where from
+    bool refreshing = false;
+    int nextFace = 0;
+    glm::vec3 refreshPos{ 0.0f };
+    float refreshSunAngle = 0.0f;
+
+    // The front cubemap is drawn, the other one refreshed
+    unsigned int cubemaps[2] = { 0, 0 };
+    int front = 0;
+    unsigned int depthBuffer = 0;
+    unsigned int FBO = 0;
+    unsigned int cubeVAO = 0;
+    unsigned int cubeVBO = 0;
+};
+
+#endif
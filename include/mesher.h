@@ -0,0 +1,113 @@
+#ifndef MESHER_H
+#define MESHER_H
+
+#include <cstdint>
+#include <vector>
+#include "chunk.h"
+
+class World;
+
+// Face order used by the mesher and the shaders: -z, +z, -x, +x, -y, +y
+enum Face : uint32_t {
+    FACE_FRONT = 0,
+    FACE_BACK,
+    FACE_LEFT,
+    FACE_RIGHT,
+    FACE_BOTTOM,
+    FACE_TOP
+};
+
+// Packed chunk quad, two 32-bit words per quad. The vertex shaders fetch it from a buffer
+// texture and expand it using gl_VertexID. Word 0:
+//   bits  0-4   x block position within the chunk of the quad's minimum corner
+//   bits  5-9   y
+//   bits 10-14  z
+//   bits 15-17  face index
+//   bits 18-20  block type, which selects the texture layers and tint
+//   bits 21-28  ambient occlusion, 2 bits per corner (0 = unoccluded .. 3 = fully occluded)
+//   bit  29     flip, split the quad along the 1-3 diagonal instead of 0-2
+inline uint32_t packFace(uint32_t x, uint32_t y, uint32_t z, uint32_t face, uint32_t block, uint32_t ao, uint32_t flip) {
+    return x | (y << 5) | (z << 10) | (face << 15) | (block << 18) | (ao << 21) | (flip << 29);
+}
+
+// The block type field is full. Another block type needs it widened into the free bits
+// 30-31, along with the face keys in mesher.cpp and the shaders that unpack the record.
+static_assert(BLOCK_TYPE_COUNT <= 8, "block types no longer fit in 3 bits of a quad record");
+
+// Word 1, the quad's size in blocks along the two axes spanning the face: width along
+// axis (n + 1) % 3 and height along (n + 2) % 3, where n is the normal's axis
+//   bits  0-4   width - 1
+//   bits  5-9   height - 1
+//   bits 10-31  chunk slot, left 0 by the meshers and set by the renderer to find the
+//               chunk's transform
+inline uint32_t packFaceSize(uint32_t width, uint32_t height) {
+    return (width - 1) | ((height - 1) << 5);
+}
+
+const int FACE_SLOT_SHIFT = 10;
+
+const int FACE_RECORD_WORDS = 2;
+
+// Side of a chunk plus its one block apron on each side
+const int PADDED_SIZE = CHUNK_SIZE + 2;
+
+// A copy of a chunk with a one block apron taken from its neighbours, so meshing never
+// looks outside it. Above and below the world, and beyond its edges, is air. The copy is
+// also a consistent snapshot, so it can be meshed while the world keeps changing.
+struct PaddedChunk {
+    // Block types indexed [x + 1][y + 1][z + 1]
+    uint8_t blocks[PADDED_SIZE][PADDED_SIZE][PADDED_SIZE];
+};
+
+// Gather a chunk and the apron from its side and diagonal neighbours in one pass
+void copyPadded(const World& world, const Chunk& chunk, PaddedChunk& padded);
+
+// Coarsest level of detail; level l merges 2^l blocks along each axis into one cell
+const int MAX_LOD = 3;
+
+// Side of the largest cell, in blocks
+const int MAX_CELL_BLOCKS = 1 << MAX_LOD;
+
+// Side of a chunk plus an apron one coarsest cell wide on each side
+const int SNAPSHOT_SIZE = CHUNK_SIZE + 2 * MAX_CELL_BLOCKS;
+
+// The blocks a downsampled chunk is built from: the chunk and an apron of up to one cell
+// from its neighbours. Taken on the render thread so downsampling can run on a worker.
+struct ChunkSnapshot {
+    // Block types indexed [x + MAX_CELL_BLOCKS][y][z + MAX_CELL_BLOCKS]
+    uint8_t blocks[SNAPSHOT_SIZE][CHUNK_HEIGHT][SNAPSHOT_SIZE];
+};
+
+// Copy a chunk and an apron `factor` blocks wide, with air beyond the world and the apron
+void copySnapshot(const World& world, const Chunk& chunk, int factor, ChunkSnapshot& snapshot);
+
+// Downsample a snapshot and a one cell apron into cells of factor^3 blocks, stored like a
+// PaddedChunk of CHUNK_SIZE / factor cells a side with air beyond. A cell is filled when at
+// least half of its blocks are, and takes the type of its highest block, which is the one
+// seen from above.
+void downsample(const ChunkSnapshot& snapshot, int factor, PaddedChunk& cells);
+
+// Reference mesher: one unit quad per visible face of the opaque blocks, with baked corner
+// ambient occlusion. Faces against opaque blocks in the neighbouring chunks are culled too.
+void meshChunk(const PaddedChunk& chunk, std::vector<uint32_t>& faces);
+
+// Same faces as meshChunk, found with shifts and masks on 64-bit occupancy rows and
+// merged into larger quads where neighbouring faces share a block type and occlusion that
+// is the same at all four corners. Faces with uneven occlusion are kept as unit quads.
+// A downsampled chunk (see downsample) is meshed by passing its size in cells.
+void meshChunkGreedy(const PaddedChunk& chunk, std::vector<uint32_t>& faces, int size = CHUNK_SIZE);
+
+// Append skirts: the faces on the chunk's four sides that were culled against the apron.
+// They are only drawn next to chunks at another level of detail, where they cover the
+// cracks between the two surfaces. Returns the number of quads appended.
+int appendSkirts(const PaddedChunk& cells, int size, std::vector<uint32_t>& faces);
+
+// Unit quads for the visible faces of translucent blocks, without occlusion. They are never
+// merged, so each can be sorted on its own.
+void meshTranslucent(const PaddedChunk& chunk, std::vector<uint32_t>& faces, int size = CHUNK_SIZE);
+
+// Order unit quads back to front as seen from an eye given in the chunk's cell units (cell i
+// spanning [i, i + 1)), so they blend correctly when drawn in order
+void sortBackToFront(std::vector<uint32_t>& faces, float eyeX, float eyeY, float eyeZ);
+
+#endif
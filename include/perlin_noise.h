@@ -3,20 +3,21 @@
 
 #include <vector>
 #include <numeric>
-#include <random>
-#include <algorithm>
+#include <cstdint>
 #include <cmath>
+#include "random.h"
 
 class PerlinNoise {
 public:
-    PerlinNoise(unsigned int seed = std::default_random_engine::default_seed) {
+    PerlinNoise(uint64_t seed = DEFAULT_WORLD_SEED) {
         // Initialize the permutation vector with the reference values
         p.resize(256);
         std::iota(p.begin(), p.end(), 0);
 
-        // Shuffle using the given seed
-        std::default_random_engine engine(seed);
-        std::shuffle(p.begin(), p.end(), engine);
+        // Shuffle using the given seed; the generator is portable so every platform
+        // builds the same permutation
+        SplitMix64 rng(seed);
+        portableShuffle(p, rng);
 
         // Duplicate the permutation vector
         p.insert(p.end(), p.begin(), p.end());
@@ -47,11 +48,58 @@ public:
         return (res + 1.0) / 2.0; // Map the result to [0, 1]
     }
 
+    // Same value as noise(x, y), plus the analytic partial derivatives d/dx and d/dy
+    // computed in the same pass. Corner gradients come from lookup tables so the
+    // body has no data-dependent branches and vectorizes well over a row of samples.
+    double noise(double x, double y, double& dx, double& dy) const {
+        int X = static_cast<int>(std::floor(x)) & 255;
+        int Y = static_cast<int>(std::floor(y)) & 255;
+
+        x -= std::floor(x);
+        y -= std::floor(y);
+
+        double u = fade(x);
+        double v = fade(y);
+        double du = fadeDerivative(x);
+        double dv = fadeDerivative(y);
+
+        int aa = p[p[p[X] + Y]] & 3;
+        int ab = p[p[p[X] + Y + 1]] & 3;
+        int ba = p[p[p[X + 1] + Y]] & 3;
+        int bb = p[p[p[X + 1] + Y + 1]] & 3;
+
+        // Corner contributions (dot of gradient with the offset to the corner)
+        double a = GRAD_X[aa] * x + GRAD_Y[aa] * y;
+        double b = GRAD_X[ba] * (x - 1) + GRAD_Y[ba] * y;
+        double c = GRAD_X[ab] * x + GRAD_Y[ab] * (y - 1);
+        double d = GRAD_X[bb] * (x - 1) + GRAD_Y[bb] * (y - 1);
+
+        double res = lerp(v, lerp(u, a, b), lerp(u, c, d));
+
+        // n = a + u(b - a) + v(c - a) + uv(a - b - c + d), differentiated term by term
+        double k = a - b - c + d;
+        double kx = GRAD_X[aa] - GRAD_X[ba] - GRAD_X[ab] + GRAD_X[bb];
+        double ky = GRAD_Y[aa] - GRAD_Y[ba] - GRAD_Y[ab] + GRAD_Y[bb];
+        dx = GRAD_X[aa] + u * (GRAD_X[ba] - GRAD_X[aa]) + v * (GRAD_X[ab] - GRAD_X[aa]) + u * v * kx
+            + du * ((b - a) + v * k);
+        dy = GRAD_Y[aa] + u * (GRAD_Y[ba] - GRAD_Y[aa]) + v * (GRAD_Y[ab] - GRAD_Y[aa]) + u * v * ky
+            + dv * ((c - a) + u * k);
+
+        // Same [0, 1] remap as noise(), which halves the derivatives too
+        dx *= 0.5;
+        dy *= 0.5;
+        return (res + 1.0) / 2.0;
+    }
+
 private:
     double fade(double t) const {
         return t * t * t * (t * (t * 6 - 15) + 10);
     }
 
+    double fadeDerivative(double t) const {
+        return 30.0 * t * t * (t * (t - 2.0) + 1.0);
+    }
+
     double lerp(double t, double a, double b) const {
         return a + t * (b - a);
     }
@@ -63,6 +111,10 @@ private:
         return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
     }
 
+    // Gradient vectors selected by grad() for each value of (hash & 3)
+    static constexpr double GRAD_X[4] = { 1.0, -1.0, -1.0, -1.0 };
+    static constexpr double GRAD_Y[4] = { 1.0, 1.0, 1.0, -1.0 };
+
     std::vector<int> p;
 };
 
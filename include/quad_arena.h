@@ -0,0 +1,109 @@
+#ifndef QUAD_ARENA_H
+#define QUAD_ARENA_H
+
+#include <glad/glad.h>
+#include <vector>
+#include <set>
+#include <cstdint>
+
+// Smallest block an arena hands out, in quads; every block is this times a power of two
+const int ARENA_BLOCK_QUADS = 16;
+
+// Occupancy and fragmentation of an arena, in quads
+struct ArenaStats {
+    int capacity = 0;
+    int used = 0;      // Quads asked for by live allocations
+    int reserved = 0;  // Quads of the blocks holding them, after rounding up to a size class
+    int free = 0;      // Quads in free blocks
+    int largestFree = 0;
+    int allocations = 0;
+    long long movedQuads = 0; // Quads copied by compaction since the arena was made
+    int grows = 0;
+    int shrinks = 0;
+
+    float occupancy() const { return capacity > 0 ? static_cast<float>(used) / capacity : 0.0f; }
+
+    // Share of free space that can't be handed out as one block
+    float fragmentation() const { return free > 0 ? 1.0f - static_cast<float>(largestFree) / free : 0.0f; }
+};
+
+// One large GL buffer of packed quad records shared by many chunk meshes, read through a
+// single buffer texture so every mesh in it can be drawn with one multi-draw. Space is
+// handed out in power of two size classes, buddy style: each class has its own free list,
+// bigger blocks split to serve smaller ones, and a freed block merges with its buddy when
+// that is free too. The buffer doubles by copying when nothing fits, and compact() moves
+// live blocks out of the upper half a few at a time so it can halve again once the meshes
+// in it have shrunk.
+class QuadArena {
+public:
+    // Sizes are in quads; maxQuads is the most a buffer texture can address
+    QuadArena(int initialQuads, int maxQuads);
+    ~QuadArena();
+
+    QuadArena(const QuadArena&) = delete;
+    QuadArena& operator=(const QuadArena&) = delete;
+
+    // Handle to a new range of `quads`, or -1 if it can't fit even at the largest size.
+    // Compaction may move the range; look up where it starts with getFirst().
+    int allocate(int quads);
+    void free(int handle);
+
+    // First quad of an allocation, as the arena is laid out now
+    int getFirst(int handle) const { return allocations[handle].first; }
+
+    // Write records into the start of an allocation
+    void upload(int handle, const uint32_t* records, int quads);
+
+    // Copy records from another GL buffer into the start of an allocation
+    void copy(int handle, unsigned int source, GLintptr sourceOffset, int quads);
+
+    // Move up to maxMoves live blocks out of the upper half, and halve the buffer once
+    // that is empty. Does nothing while more than a quarter of the arena is in use.
+    void compact(int maxMoves);
+
+    ArenaStats getStats() const;
+    unsigned int getTexture() const { return texture; }
+    int getCapacity() const { return capacity; }
+
+private:
+    struct Allocation {
+        int first = -1; // -1 while the handle is unused
+        int quads = 0;
+        int sizeClass = 0;
+    };
+
+    // Size class whose blocks hold `quads`
+    static int sizeClassFor(int quads);
+    static int blockQuads(int sizeClass) { return ARENA_BLOCK_QUADS << sizeClass; }
+
+    // Take a free block of a class, splitting a bigger one if needed, from below `limit`.
+    // Returns its first quad, or -1 if there isn't one.
+    int takeBlock(int sizeClass, int limit);
+
+    // Return a block to the free lists, merging it with its buddy while that is free
+    void releaseBlock(int first, int sizeClass);
+
+    // Replace the buffer with one of newCapacity quads, keeping the first `keep` quads
+    void resize(int newCapacity, int keep);
+
+    int capacity;
+    int initialCapacity;
+    int maxQuads;
+    int topClass; // Size class of a block spanning the whole arena
+
+    // First quads of the free blocks of each size class, lowest first
+    std::vector<std::set<int>> freeLists;
+    std::vector<Allocation> allocations;
+    std::vector<int> freeHandles;
+
+    int usedQuads = 0;
+    int reservedQuads = 0;
+    long long movedQuads = 0;
+    int grows = 0;
+    int shrinks = 0;
+
+    unsigned int buffer = 0;
+    unsigned int texture = 0;
+};
+
+#endif
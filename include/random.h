@@ -0,0 +1,56 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+// Seed used when none is given on the command line
+const uint64_t DEFAULT_WORLD_SEED = 1;
+
+// SplitMix64: tiny, fast and fully specified, so the same seed produces the same
+// sequence on every compiler and standard library (unlike std::default_random_engine
+// combined with std::shuffle or the std distributions)
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform integer in [0, bound) without modulo bias
+    uint32_t nextBelow(uint32_t bound) {
+        uint32_t threshold = static_cast<uint32_t>(-bound) % bound;
+        for (;;) {
+            uint32_t r = static_cast<uint32_t>(next() >> 32);
+            if (r >= threshold)
+                return r % bound;
+        }
+    }
+
+private:
+    uint64_t state;
+};
+
+// Fisher-Yates shuffle with a portable generator
+template <typename T>
+void portableShuffle(std::vector<T>& values, SplitMix64& rng) {
+    for (size_t i = values.size(); i > 1; i--) {
+        size_t j = rng.nextBelow(static_cast<uint32_t>(i));
+        std::swap(values[i - 1], values[j]);
+    }
+}
+
+// Independent seed for one chunk, derived only from the world seed and its coordinates,
+// so a chunk generates identically no matter which thread or machine builds it
+inline uint64_t deriveChunkSeed(uint64_t worldSeed, int chunkX, int chunkZ) {
+    uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(chunkX)) << 32) | static_cast<uint32_t>(chunkZ);
+    SplitMix64 rng(worldSeed ^ SplitMix64(key).next());
+    return rng.next();
+}
+
+#endif
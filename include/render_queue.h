@@ -0,0 +1,73 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+// Passes in the order they run. Opaque things come first so the background only fills
+// what is left of the sky, and translucent things last, over all of it. The optional depth
+// prepass lays down opaque depth before anything is shaded.
+enum RenderPass {
+    PASS_SHADOW,
+    PASS_DEPTH_PREPASS,
+    PASS_OPAQUE,
+    PASS_BACKGROUND,
+    PASS_TRANSLUCENT
+};
+
+// Number of distinct depths a sort key can tell apart
+const int DEPTH_BUCKETS = 1 << 16;
+
+// State changes between consecutive draws
+struct StateChanges {
+    int programs = 0;
+    int materials = 0;
+    int vertexArrays = 0;
+
+    int total() const { return programs + materials + vertexArrays; }
+};
+
+// One entry in a render queue: the state it needs, and the call that draws it
+struct DrawItem {
+    uint64_t key = 0;
+    unsigned int program = 0;
+    unsigned int material = 0; // Texture the draw samples most, 0 for none
+    unsigned int vertexArray = 0;
+    std::function<void()> draw;
+};
+
+// Sort key of a draw. Bits 56-63 hold the pass, then program (12 bits), material (12 bits)
+// and depth bucket (16 bits), so draws sharing state end up together; opaque draws go
+// front to back within a run of the same state. In the translucent pass depth comes right
+// after the pass instead, back to front, since blending needs that order whatever it costs.
+uint64_t makeSortKey(RenderPass pass, unsigned int program, unsigned int material, float depth, float maxDepth);
+
+// Draws pushed in any order over a frame, radix sorted by key and issued in one go
+class RenderQueue {
+public:
+    void push(DrawItem item);
+
+    // Sort by key, then draw everything and empty the queue
+    void execute();
+
+    // State changes of the last frame executed, in the order the items were pushed and in
+    // the order they were drawn
+    const StateChanges& getUnsortedChanges() const { return unsortedChanges; }
+    const StateChanges& getSortedChanges() const { return sortedChanges; }
+    int getLastItemCount() const { return lastItemCount; }
+
+private:
+    // Least significant digit first, a byte at a time; digits every key shares are skipped
+    void radixSort();
+
+    static StateChanges countChanges(const std::vector<DrawItem>& items);
+
+    std::vector<DrawItem> items;
+    std::vector<DrawItem> scratch;
+    StateChanges unsortedChanges;
+    StateChanges sortedChanges;
+    int lastItemCount = 0;
+};
+
+#endif
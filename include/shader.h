@@ -12,7 +12,9 @@ class Shader
 {
 public:
     unsigned int ID;
-    Shader(const char* vertexPath, const char* fragmentPath);
+    // vertexHeaderPath, when given, names GLSL put in front of the vertex shader: its
+    // #version line and whatever declarations several vertex shaders share
+    Shader(const char* vertexPath, const char* fragmentPath, const char* vertexHeaderPath = nullptr);
     void use();
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
@@ -21,7 +23,13 @@ public:
     void setVec3(const std::string& name, const glm::vec3& value) const;
 
 private:
+    // Whole contents of a shader source file, or an empty string if it can't be read
+    static std::string readSource(const char* path);
+
     void checkCompileErrors(unsigned int shader, std::string type);
+
+    // Attach each uniform block the program uses to its fixed binding point
+    void bindUniformBlocks();
 };
 
 #endif
@@ -0,0 +1,52 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+
+// Frames of stream data in flight: the CPU writes one while the GPU may still be reading
+// the ones before it
+const int STREAM_FRAMES = 3;
+
+// A ring of per-frame regions in one GL buffer, for data written by the CPU every frame
+// and read by the GPU shortly after: mesh uploads on their way to an arena, draw
+// commands, transforms. Each region is fenced when its frame ends and only written again
+// once the GPU has passed the fence, so writes never wait on draws that are still queued.
+// The buffer is mapped once, persistent and coherent, where the context has
+// GL_ARB_buffer_storage (GL 4.4); otherwise each write maps its range unsynchronized,
+// which the fences make safe.
+class StreamBuffer {
+public:
+    // frameBytes is the space each frame gets
+    explicit StreamBuffer(size_t frameBytes);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Fence the frame just written and move on to the next region, waiting for the GPU to
+    // finish with it if it hasn't yet. Call once per frame before any write().
+    void nextFrame();
+
+    // Copy data into this frame's region. Returns its offset in the buffer, or -1 if the
+    // region is full, in which case the caller uploads some other way.
+    GLintptr write(const void* data, size_t bytes, size_t alignment = 16);
+
+    unsigned int getBuffer() const { return buffer; }
+    bool isPersistent() const { return mapped != nullptr; }
+
+    // Frames nextFrame() had to wait for the GPU
+    int getStalls() const { return stalls; }
+
+private:
+    size_t frameBytes;
+    int frame = 0;
+    size_t used = 0;
+    GLsync fences[STREAM_FRAMES] = {};
+    int stalls = 0;
+
+    unsigned int buffer = 0;
+    unsigned char* mapped = nullptr;
+};
+
+#endif
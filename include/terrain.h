@@ -0,0 +1,66 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <glm/glm.hpp>
+#include "perlin_noise.h"
+#include "chunk.h"
+
+const int MAX_HEIGHT = 24;
+
+// Perlin noise parameters
+const int OCTAVES = 4;
+const float FREQUENCY = 0.02f;
+const float PERSISTENCE = 0.5f;
+
+// Columns per height sample for chunks generated at coarse detail
+const int COARSE_STEP = 4;
+
+// Columns whose slope, in blocks of height per column, is above this are bare stone
+// instead of grass. About one column in ten of the default noise is this steep.
+const float STEEP_SLOPE = 0.5f;
+
+float perlinNoise(float x, float y, const PerlinNoise& perlin);
+// fBm with only the first `octaves` octaves; the dropped ones contribute their mean
+float perlinNoise(float x, float y, const PerlinNoise& perlin, int octaves);
+float perlinNoise(float x, float y, const PerlinNoise& perlin, glm::vec2& gradient);
+
+// Anything that can provide raw (unsmoothed) column heights for the chunk pipeline.
+// Implementations must be safe to call from several worker threads at once.
+class HeightSource {
+public:
+    virtual ~HeightSource() = default;
+
+    // Fill out[x * depth + z] with the heights of the width x depth columns starting at
+    // world column (x0, z0), and slopes[x * depth + z] with their slopes: the length of
+    // the height gradient, in blocks per column. Coordinates may fall outside the world for
+    // the smoothing apron.
+    virtual void sampleHeights(int x0, int z0, int width, int depth, int* out, float* slopes) const = 0;
+
+    // Unrounded height of one column for coarse generation. Detail finer than `step`
+    // columns can be skipped since it will be interpolated away.
+    virtual float sampleCoarseHeight(int x, int z, int step) const = 0;
+};
+
+// Procedural heights from fBm Perlin noise, with slopes from its analytic gradient
+class NoiseHeightSource : public HeightSource {
+public:
+    explicit NoiseHeightSource(const PerlinNoise& perlin) : perlin(perlin) {}
+
+    void sampleHeights(int x0, int z0, int width, int depth, int* out, float* slopes) const override;
+    float sampleCoarseHeight(int x, int z, int step) const override;
+
+private:
+    const PerlinNoise& perlin;
+};
+
+// Generate one chunk: sample its columns plus a one-column apron from the source,
+// apply the 3x3 smoothing filter and fill the blocks, so chunks can be built independently.
+// Steep columns are stone above the sand.
+void generateChunk(Chunk& chunk, const HeightSource& source);
+
+// Quick low-detail version of generateChunk: one sample every `step` columns, bilinearly
+// interpolated and unsmoothed. Samples on the chunk edges are shared with the neighbours
+// so coarse chunks still join up.
+void generateCoarseChunk(Chunk& chunk, const HeightSource& source, int step);
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <atomic>
+
+// Fixed set of worker threads pulling jobs from a shared queue. Urgent jobs have a lane of
+// their own, which workers empty before taking anything else.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency()) {
+        if (threadCount == 0)
+            threadCount = 1;
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int size() const {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+    // Queue a job to run on some worker; returns immediately
+    void submit(std::function<void()> job, bool urgent = false) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            (urgent ? urgentJobs : jobs).push_back(std::move(job));
+        }
+        jobAvailable.notify_one();
+    }
+
+    // Run fn(i) for every i in [0, count) across the workers and block until all are done
+    void parallelFor(int count, const std::function<void(int)>& fn, bool urgent = false) {
+        if (count <= 0)
+            return;
+
+        std::atomic<int> next(0);
+        int remaining = static_cast<int>(size());
+        std::mutex doneMutex;
+        std::condition_variable done;
+
+        for (unsigned int w = 0; w < size(); w++) {
+            submit([&] {
+                for (int i = next++; i < count; i = next++)
+                    fn(i);
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if (--remaining == 0)
+                    done.notify_one();
+            }, urgent);
+        }
+
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait(lock, [&] { return remaining == 0; });
+    }
+
+private:
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock, [this] { return stopping || !urgentJobs.empty() || !jobs.empty(); });
+                std::deque<std::function<void()>>& lane = urgentJobs.empty() ? jobs : urgentJobs;
+                if (stopping && lane.empty())
+                    return;
+                job = std::move(lane.front());
+                lane.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::deque<std::function<void()>> urgentJobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    bool stopping = false;
+};
+
+#endif
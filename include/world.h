@@ -0,0 +1,87 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+#include "chunk.h"
+#include "terrain.h"
+#include "thread_pool.h"
+#include "random.h"
+
+// A single block change requested by the player, in world block coordinates
+struct BlockEdit {
+    int x;
+    int y;
+    int z;
+    uint8_t block;
+};
+
+// A fixed rectangle of chunks, generated in parallel from a HeightSource
+class World {
+public:
+    World(int chunksX, int chunksZ, uint64_t seed = DEFAULT_WORLD_SEED);
+
+    // Build every chunk from the source, one job per chunk: terrain and decoration
+    // candidates first, then decorations once all neighbours are available
+    void generate(const HeightSource& source, ThreadPool& pool);
+
+    // Generate every chunk at coarse detail only, so the whole world is visible quickly
+    void generateCoarse(const HeightSource& source, ThreadPool& pool);
+
+    // Refine up to maxChunks coarse chunks within `radius` columns of the camera to full
+    // detail, nearest first and preferring those in front of the camera. Chunks are
+    // decorated as soon as they and all their neighbours are at full detail. The work goes
+    // on the pool's urgent lane, so it doesn't wait behind queued mesh jobs.
+    // Returns the number of chunks refined.
+    int refine(const HeightSource& source, ThreadPool& pool, glm::vec2 cameraColumn, glm::vec2 viewDirection,
+        float radius, int maxChunks);
+
+    uint64_t getSeed() const { return seed; }
+    int getChunksX() const { return chunksX; }
+    int getChunksZ() const { return chunksZ; }
+    int getSizeX() const { return chunksX * CHUNK_SIZE; }
+    int getSizeZ() const { return chunksZ * CHUNK_SIZE; }
+
+    Chunk* getChunk(int chunkX, int chunkZ);
+    const Chunk* getChunk(int chunkX, int chunkZ) const;
+
+    // Height of world column (x, z); 0 outside the world
+    int getHeight(int x, int z) const;
+
+    // Block at world position (x, y, z); air outside the world
+    uint8_t getBlock(int x, int y, int z) const;
+
+    // Flag the meshes of a chunk and its neighbours for rebuilding after its blocks changed
+    void markMeshDirty(int chunkX, int chunkZ);
+
+    // Queue a block change. Edits are only applied by applyEdits(), so any number made
+    // during a frame cost one remesh per affected chunk.
+    void queueEdit(int x, int y, int z, uint8_t block);
+
+    // Apply the queued edits and flag only the chunks whose meshes they affect: the edited
+    // chunk, plus the neighbours across any border the block touches. Edits to chunks that
+    // are not yet fully generated would be overwritten, so they are dropped. Returns the
+    // number of blocks changed.
+    int applyEdits();
+
+    // Walk the blocks along a ray (in block units, block (x, y, z) spanning [x, x + 1) on
+    // each axis) and report the first solid one and the empty block just before it. Water
+    // counts as empty. Returns false if nothing solid is hit within maxDistance.
+    bool raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, glm::ivec3& hit, glm::ivec3& before) const;
+
+    // FNV-1a hash of a chunk's heights and blocks, for comparing generation runs
+    uint64_t hashChunk(int chunkX, int chunkZ) const;
+
+private:
+    // True when the chunk and all its existing neighbours are at full detail
+    bool canDecorate(const Chunk& chunk) const;
+
+    uint64_t seed;
+    int chunksX;
+    int chunksZ;
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    std::vector<BlockEdit> pendingEdits;
+};
+
+#endif
@@ -0,0 +1,7 @@
+// Follows quad_common.glsl. Depth prepass: positions exactly as vertex_shader.vs computes
+// them, so the shading pass can test against the prepass depth with GL_EQUAL.
+
+void main()
+{
+    gl_Position = cameraClipPosition(pullQuadVertex().worldPosition);
+}
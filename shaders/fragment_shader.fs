@@ -4,61 +4,97 @@ out vec4 FragColor;
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+flat in uint TexLayer;
+flat in uint Tint;
+in float Occlusion;
 
-uniform sampler2D topTexture;
-uniform sampler2D sideTexture;
-uniform sampler2D bottomTexture;
-uniform sampler2D shadowMap;
+uniform sampler2DArray blockTextures;
+uniform sampler2DShadow shadowMap;
+// 0: 1 tap, 1: 4 taps, 2: 9 taps, 3: Poisson disk (ShadowKernel in main.cpp)
+uniform int shadowKernel;
+uniform float shadowRadius; // Spacing of the taps, in shadow map texels
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform mat4 lightSpaceMatrix;
+// Per-frame values, written once a frame (see frame_uniforms.h)
+layout(std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec3 viewPos;
+    vec3 lightPos;
+    vec3 sunPosition;
+    vec3 fogColor;
+    float renderDistance;
+};
 
-uniform bool isSun;
-uniform float renderDistance;
-uniform vec3 sunPosition;
-uniform vec3 fogColor;
+// Colour multiplier per block type, for blocks that share another block's texture
+const vec3 BLOCK_TINTS[8] = vec3[8](
+    vec3(1.0), vec3(1.0), vec3(1.0),  // air, sand, grass
+    vec3(0.55, 0.4, 0.3),             // wood
+    vec3(0.45, 0.7, 0.4),             // leaves
+    vec3(0.55, 0.55, 0.6),            // stone
+    vec3(0.25, 0.45, 0.75),           // water
+    vec3(0.85, 0.95, 1.0)             // glass
+);
 
+// Opacity per block type; only water and glass are blended
+const float BLOCK_ALPHA[8] = float[8](1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 0.6, 0.25);
+
+// Unit disk offsets for the Poisson kernel
+const vec2 POISSON_DISK[8] = vec2[8](
+    vec2(-0.942016, -0.399062), vec2(0.945586, -0.768907),
+    vec2(-0.094184, -0.929389), vec2(0.344959, 0.293878),
+    vec2(-0.915886, 0.457714), vec2(-0.815442, -0.879125),
+    vec2(-0.382775, 0.276768), vec2(0.974844, 0.756484)
+);
+
+// Each tap compares in hardware and blends the 2x2 texels around it, so a few taps
+// cover what took a 3x3 grid of manual fetches
 float ShadowCalculation(vec4 fragPosLightSpace)
 {
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    projCoords = projCoords * 0.5 + 0.5;    
-    
-    float currentDepth = projCoords.z;
-    float shadow = 0.0;
+    projCoords = projCoords * 0.5 + 0.5;
+    if(projCoords.z > 1.0)
+        return 0.0;
+
     float bias = 0.005;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
-    for(int x = -1; x <= 1; ++x)
+    vec3 reference = vec3(projCoords.xy, projCoords.z - bias);
+    vec2 texelSize = shadowRadius / vec2(textureSize(shadowMap, 0));
+    float lit = 0.0;
+    if (shadowKernel == 0)
+    {
+        lit = texture(shadowMap, reference);
+    }
+    else if (shadowKernel == 1)
     {
-        for(int y = -1; y <= 1; ++y)
+        // A texel either side, which together cover 4x4 texels
+        for(int i = 0; i < 4; ++i)
         {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
-            shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;
+            vec2 offset = vec2(float(i & 1), float(i >> 1)) * 2.0 - 1.0;
+            lit += texture(shadowMap, reference + vec3(offset * texelSize, 0.0));
         }
+        lit /= 4.0;
     }
-    shadow /= 9.0;
-
-    if(projCoords.z > 1.0)
-        shadow = 0.0;
-
-    return shadow;
+    else if (shadowKernel == 2)
+    {
+        for(int x = -1; x <= 1; ++x)
+        {
+            for(int y = -1; y <= 1; ++y)
+                lit += texture(shadowMap, reference + vec3(vec2(x, y) * texelSize, 0.0));
+        }
+        lit /= 9.0;
+    }
+    else
+    {
+        for(int i = 0; i < 8; ++i)
+            lit += texture(shadowMap, reference + vec3(POISSON_DISK[i] * texelSize, 0.0));
+        lit /= 8.0;
+    }
+    return 1.0 - lit;
 }
 
 void main()
 {
-    if (isSun) {
-        FragColor = vec4(1.0, 1.0, 0.0, 1.0);
-        return;
-    }
-
-    vec3 color;
-    if (Normal.y > 0.5) { // Top face
-        color = texture(topTexture, TexCoords).rgb;
-    } else if (Normal.y < -0.5) { // Bottom face
-        color = texture(bottomTexture, TexCoords).rgb;
-    } else { // Side faces
-        color = texture(sideTexture, TexCoords).rgb;
-    }
+    vec3 color = texture(blockTextures, vec3(TexCoords, float(TexLayer))).rgb * BLOCK_TINTS[Tint];
 
     vec3 normal = normalize(Normal);
     vec3 lightColor = vec3(1.0);
@@ -81,11 +117,18 @@ void main()
     vec4 fragPosLightSpace = lightSpaceMatrix * vec4(FragPos, 1.0);
     float shadow = ShadowCalculation(fragPosLightSpace);
     vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;
+    lighting *= 1.0 - 0.6 * Occlusion;
 
     // Fog effect
     float distance = length(viewPos - FragPos);
     float fogFactor = clamp((distance - 4.0) / (renderDistance - 4.0), 0.0, 1.0);
     lighting = mix(lighting, fogColor, fogFactor);
 
-    FragColor = vec4(lighting, 1.0);
+    // Glass is clear apart from a frame around each block
+    float alpha = BLOCK_ALPHA[Tint];
+    vec2 cell = fract(TexCoords);
+    if (Tint == 7u && min(min(cell.x, 1.0 - cell.x), min(cell.y, 1.0 - cell.y)) < 0.06)
+        alpha = 0.9;
+
+    FragColor = vec4(lighting, alpha);
 }
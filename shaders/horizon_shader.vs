@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+out vec3 Direction;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    Direction = aPos;
+    // Depth of 1 puts the cube at the far plane, behind all the terrain
+    vec4 position = projection * view * vec4(aPos, 1.0);
+    gl_Position = position.xyww;
+}
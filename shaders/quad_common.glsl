@@ -0,0 +1,75 @@
+#version 330 core
+// Put in front of every vertex shader that draws chunk quads (see Shader). No vertex
+// attributes: each quad is one packed record (see mesher.h) fetched from a buffer texture,
+// and drawn with the shared quad index pattern so gl_VertexID is quad * 4 + corner.
+
+// Every pass over the same quads puts their vertices in exactly the same place, for the
+// GL_EQUAL depth test after a depth prepass
+invariant gl_Position;
+
+uniform usamplerBuffer faces;
+// World-space origin (xyz) and size of a position unit (w) of each chunk, found by the slot
+// in the quad's record. Chunks are only ever moved and uniformly scaled.
+uniform samplerBuffer chunkTransforms;
+// Per-frame values, written once a frame (see frame_uniforms.h)
+layout(std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec3 viewPos;
+    vec3 lightPos;
+    vec3 sunPosition;
+    vec3 fogColor;
+    float renderDistance;
+};
+
+// Corner offsets of each face, counter-clockwise seen from outside the block
+const vec3 FACE_CORNERS[24] = vec3[24](
+    vec3(0, 0, 0), vec3(0, 1, 0), vec3(1, 1, 0), vec3(1, 0, 0),
+    vec3(0, 0, 1), vec3(1, 0, 1), vec3(1, 1, 1), vec3(0, 1, 1),
+    vec3(0, 0, 0), vec3(0, 0, 1), vec3(0, 1, 1), vec3(0, 1, 0),
+    vec3(1, 0, 0), vec3(1, 1, 0), vec3(1, 1, 1), vec3(1, 0, 1),
+    vec3(0, 0, 0), vec3(1, 0, 0), vec3(1, 0, 1), vec3(0, 0, 1),
+    vec3(0, 1, 0), vec3(0, 1, 1), vec3(1, 1, 1), vec3(1, 1, 0)
+);
+
+// Axis of each face's normal; the quad's width and height run along the next two
+const int FACE_AXES[6] = int[6](2, 2, 0, 0, 1, 1);
+
+// This vertex's corner of its quad
+struct QuadVertex {
+    uint record;        // Word 0 of the quad's record
+    uint face;
+    int corner;         // Corner of the unit face, after the flip
+    vec3 position;      // Chunk-local, in position units
+    vec3 worldPosition;
+};
+
+QuadVertex pullQuadVertex()
+{
+    uvec2 quad = texelFetch(faces, gl_VertexID >> 2).rg;
+    QuadVertex result;
+    result.record = quad.x;
+    result.face = (quad.x >> 15) & 7u;
+
+    // Rotating the corners by one turns the shared 0-2 diagonal into 1-3
+    result.corner = (gl_VertexID + int((quad.x >> 29) & 1u)) & 3;
+
+    // Stretch the unit face's corner over the quad's width and height
+    vec3 offset = FACE_CORNERS[result.face * 4u + uint(result.corner)];
+    int axis = FACE_AXES[result.face];
+    offset[(axis + 1) % 3] *= float((quad.y & 31u) + 1u);
+    offset[(axis + 2) % 3] *= float(((quad.y >> 5) & 31u) + 1u);
+    result.position = vec3(quad.x & 31u, (quad.x >> 5) & 31u, (quad.x >> 10) & 31u) + offset;
+
+    // A uniform scale leaves the face normals as they are
+    vec4 chunk = texelFetch(chunkTransforms, int(quad.y >> 10));
+    result.worldPosition = chunk.xyz + result.position * chunk.w;
+    return result;
+}
+
+// Clip-space position of a world-space point for the camera
+vec4 cameraClipPosition(vec3 worldPosition)
+{
+    return projection * view * vec4(worldPosition, 1.0);
+}
@@ -1,16 +1,6 @@
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoords;
-
-uniform mat4 model;
-uniform mat4 lightSpaceMatrix;
-
-out vec4 FragPosLightSpace;
+// Follows quad_common.glsl. Depth of the quads from the light's point of view.
 
 void main()
 {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
-    FragPosLightSpace = lightSpaceMatrix * model * vec4(aPos, 1.0);
+    gl_Position = lightSpaceMatrix * vec4(pullQuadVertex().worldPosition, 1.0);
 }
-
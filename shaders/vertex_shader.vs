@@ -1,24 +1,51 @@
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoords;
+// Follows quad_common.glsl
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
-out vec4 FragPosLightSpace;
+flat out uint TexLayer;
+flat out uint Tint;
+out float Occlusion;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 lightSpaceMatrix;
+const vec3 FACE_NORMALS[6] = vec3[6](
+    vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0),
+    vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+    vec3(0.0, -1.0, 0.0), vec3(0.0, 1.0, 0.0)
+);
+
+// Texture array layer of the top, side and bottom faces of each block type
+const uvec3 BLOCK_LAYERS[8] = uvec3[8](
+    uvec3(0u), uvec3(0u),         // air, sand
+    uvec3(1u, 2u, 3u),            // grass
+    uvec3(3u), uvec3(1u),         // wood, leaves
+    uvec3(0u),                    // stone
+    uvec3(0u), uvec3(0u)          // water, glass
+);
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    TexCoords = aTexCoords;
-    FragPosLightSpace = lightSpaceMatrix * vec4(FragPos, 1.0);
+    QuadVertex quadVertex = pullQuadVertex();
+    uint face = quadVertex.face;
+    uint block = (quadVertex.record >> 18) & 7u;
+    uint ao = (quadVertex.record >> 21) & 255u;
+    vec3 aPos = quadVertex.position;
+
+    uvec3 layers = BLOCK_LAYERS[block];
+    TexLayer = face == 5u ? layers.x : (face == 4u ? layers.z : layers.y);
+    Tint = block;
+
+    // Textures repeat once per block, projected along the face normal
+    if (face < 2u)
+        TexCoords = vec2(aPos.x, -aPos.y);
+    else if (face < 4u)
+        TexCoords = vec2(aPos.z, -aPos.y);
+    else
+        TexCoords = aPos.xz;
+
+    Occlusion = float((ao >> (2 * quadVertex.corner)) & 3u) / 3.0;
+
+    FragPos = quadVertex.worldPosition;
+    Normal = FACE_NORMALS[face];
 
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = cameraClipPosition(FragPos);
 }
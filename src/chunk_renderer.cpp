@@ -0,0 +1,545 @@
+#include "chunk_renderer.h"
+#include "mesher.h"
+#include "gl_state.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <cmath>
+
+// Results that can be waiting in the queue at once. A mesh job counts as in flight from
+// dispatch until update() pops its result, and dispatch never lets more than this be in
+// flight, so a worker always finds room for its result.
+const size_t MESH_QUEUE_CAPACITY = 256;
+
+// Starting arena sizes in quads; both grow as needed
+const int OPAQUE_ARENA_QUADS = 256 * 1024;
+const int TRANSLUCENT_ARENA_QUADS = 16 * 1024;
+
+// Stamp the chunk slot into every quad of a mesh
+static void tagChunkSlot(std::vector<uint32_t>& faces, int chunkIndex) {
+    uint32_t slot = static_cast<uint32_t>(chunkIndex) << FACE_SLOT_SHIFT;
+    for (size_t i = 1; i < faces.size(); i += FACE_RECORD_WORDS)
+        faces[i] |= slot;
+}
+
+ChunkRenderer::ChunkRenderer(World& world, ThreadPool& pool, float blockScale)
+    : world(world), pool(pool), blockScale(blockScale), stream(STREAM_FRAME_BYTES), finished(MESH_QUEUE_CAPACITY),
+      // One sort job per chunk and the chunk order can be in flight at once
+      sorted(world.getChunksX() * world.getChunksZ() + 1) {
+    int chunkCount = world.getChunksX() * world.getChunksZ();
+    meshes.resize(chunkCount);
+    generations.resize(chunkCount, 0);
+    wantedLods.resize(chunkCount, 0);
+    requestedLods.resize(chunkCount, 0);
+    translucentFaces.resize(chunkCount);
+    uploadedGenerations.resize(chunkCount, 0);
+    sortedPasses.resize(chunkCount, 0);
+    sorting.resize(chunkCount, false);
+    for (int i = 0; i < chunkCount; i++)
+        drawOrder.push_back(i);
+
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    opaqueArena = std::make_unique<QuadArena>(OPAQUE_ARENA_QUADS, maxTexels);
+    translucentArena = std::make_unique<QuadArena>(TRANSLUCENT_ARENA_QUADS, maxTexels);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &quadEBO);
+    glState().bindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
+    glState().bindVertexArray(0);
+
+    glGenBuffers(1, &transformBuffer);
+    glGenTextures(1, &transformTexture);
+    glState().bindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, chunkCount * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+    glState().bindBuffer(GL_TEXTURE_BUFFER, 0);
+    glState().bindTexture(0, GL_TEXTURE_BUFFER, transformTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, transformBuffer);
+    glState().bindTexture(0, GL_TEXTURE_BUFFER, 0);
+
+    // Indirect draws need GL 4.3; the context may be older than the loader
+    indirectDraws = GLAD_GL_VERSION_4_3;
+    if (indirectDraws)
+        glGenBuffers(1, &indirectBuffer);
+}
+
+ChunkRenderer::~ChunkRenderer() {
+    // Jobs still reference this renderer and its buffers
+    waitForMeshing();
+
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &quadEBO);
+    glState().deleteTexture(transformTexture);
+    glState().deleteBuffer(transformBuffer);
+    if (indirectBuffer != 0)
+        glState().deleteBuffer(indirectBuffer);
+}
+
+void ChunkRenderer::update(glm::vec3 cameraPos) {
+    stream.nextFrame();
+
+    // Entering another block makes every translucent sort out of date
+    glm::ivec3 cell = glm::ivec3(glm::floor(cameraPos / blockScale + 0.5f));
+    if (cell != sortCell) {
+        sortCell = cell;
+        sortEye = cameraPos;
+        sortPass++;
+    }
+
+    for (int cx = 0; cx < world.getChunksX(); cx++) {
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+            wantedLods[cx * world.getChunksZ() + cz] = selectLod(cx, cz, cameraPos);
+    }
+
+    // Edited chunks jump the queue and are waited for, so an edit shows up in the frame it
+    // was made
+    meshEdits();
+    dispatch();
+
+    MeshResult result;
+    while (finished.tryPop(result)) {
+        jobsInFlight--;
+        pendingUploads.push_back(result);
+    }
+
+    // Upload finished streaming meshes, oldest first, within the frame's budget
+    size_t uploadedBytes = 0;
+    bool uploadedAny = false;
+    while (!pendingUploads.empty() && (!uploadedAny || uploadedBytes < UPLOAD_BUDGET_BYTES)) {
+        result = pendingUploads.front();
+        pendingUploads.pop_front();
+        size_t bytes = uploadResult(result);
+        uploadedBytes += bytes;
+        uploadedAny = uploadedAny || bytes > 0;
+    }
+
+    updateSorting();
+    opaqueArena->compact(ARENA_MOVES_PER_FRAME);
+    translucentArena->compact(ARENA_MOVES_PER_FRAME);
+    if (transformsDirty)
+        uploadTransforms();
+}
+
+void ChunkRenderer::uploadTransforms() {
+    // chunkModel is only ever a translation and a uniform scale, so that is all the
+    // shaders get
+    std::vector<glm::vec4> transforms(meshes.size());
+    for (int i = 0; i < static_cast<int>(meshes.size()); i++) {
+        glm::mat4 model = chunkModel(i / world.getChunksZ(), i % world.getChunksZ(), meshes[i].lod);
+        transforms[i] = glm::vec4(glm::vec3(model[3]), model[0][0]);
+    }
+    size_t bytes = transforms.size() * sizeof(glm::vec4);
+    GLintptr offset = stream.write(transforms.data(), bytes);
+    if (offset >= 0) {
+        glState().bindBuffer(GL_COPY_READ_BUFFER, stream.getBuffer());
+        glState().bindBuffer(GL_COPY_WRITE_BUFFER, transformBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, bytes);
+    }
+    else {
+        glState().bindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, transforms.data());
+    }
+    transformsDirty = false;
+}
+
+void ChunkRenderer::writeQuads(QuadArena& arena, int allocation, const uint32_t* records, int quads) {
+    GLintptr offset = stream.write(records, quads * FACE_RECORD_WORDS * sizeof(uint32_t));
+    if (offset >= 0)
+        arena.copy(allocation, stream.getBuffer(), offset, quads);
+    else
+        arena.upload(allocation, records, quads);
+}
+
+void ChunkRenderer::updateSorting() {
+    if (orderPass != sortPass && !orderSorting) {
+        MeshResult job;
+        job.chunkIndex = -1;
+        job.sortPass = sortPass;
+        job.buffer = acquireBuffer();
+        orderSorting = true;
+        sortJobsInFlight++;
+        glm::vec3 eye = sortEye;
+        pool.submit([this, job, eye] {
+            // Distances to the chunk centres, sorted far to near
+            int chunkCount = world.getChunksX() * world.getChunksZ();
+            glm::vec3 halfSize = glm::vec3(CHUNK_SIZE, CHUNK_HEIGHT, CHUNK_SIZE) * (blockScale * 0.5f);
+            std::vector<std::pair<float, int>> distances(chunkCount);
+            for (int i = 0; i < chunkCount; i++) {
+                glm::vec3 centre = glm::vec3(chunkModel(i / world.getChunksZ(), i % world.getChunksZ())[3]) + halfSize;
+                distances[i] = { glm::length(centre - eye), i };
+            }
+            std::sort(distances.begin(), distances.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+                return a.first > b.first;
+            });
+            for (const std::pair<float, int>& distance : distances)
+                job.buffer->order.push_back(distance.second);
+
+            while (!sorted.tryPush(job))
+                std::this_thread::yield();
+            sortJobsInFlight--;
+        });
+    }
+
+    for (int i = 0; i < static_cast<int>(translucentFaces.size()); i++) {
+        if (sorting[i] || sortedPasses[i] == sortPass || translucentFaces[i].empty())
+            continue;
+
+        MeshResult job;
+        job.chunkIndex = i;
+        job.generation = uploadedGenerations[i];
+        job.sortPass = sortPass;
+        job.buffer = acquireBuffer();
+        job.buffer->translucent = translucentFaces[i];
+        sorting[i] = true;
+        sortJobsInFlight++;
+        glm::vec3 eye = chunkEye(i, meshes[i].lod, sortEye);
+        pool.submit([this, job, eye] {
+            sortBackToFront(job.buffer->translucent, eye.x, eye.y, eye.z);
+            while (!sorted.tryPush(job))
+                std::this_thread::yield();
+            sortJobsInFlight--;
+        });
+    }
+
+    MeshResult result;
+    while (sorted.tryPop(result)) {
+        if (result.chunkIndex < 0) {
+            drawOrder.swap(result.buffer->order);
+            orderPass = result.sortPass;
+            orderSorting = false;
+        }
+        else {
+            // Faces of a mesh that has since been replaced are dropped
+            int i = result.chunkIndex;
+            sorting[i] = false;
+            if (result.generation == uploadedGenerations[i]) {
+                // Same faces in another order, so they go back into the same range
+                translucentFaces[i].swap(result.buffer->translucent);
+                const MeshPart& part = meshes[i].translucent;
+                writeQuads(*translucentArena, part.allocation, translucentFaces[i].data(), part.quadCount);
+                sortedPasses[i] = result.sortPass;
+            }
+        }
+        releaseBuffer(result.buffer);
+    }
+}
+
+glm::vec3 ChunkRenderer::chunkEye(int chunkIndex, int lod, glm::vec3 cameraPos) const {
+    glm::mat4 model = chunkModel(chunkIndex / world.getChunksZ(), chunkIndex % world.getChunksZ());
+    return (cameraPos - glm::vec3(model[3])) / (blockScale * (1 << lod));
+}
+
+void ChunkRenderer::meshEdits() {
+    editJobs.clear();
+    editEyes.clear();
+    for (int cx = 0; cx < world.getChunksX(); cx++) {
+        for (int cz = 0; cz < world.getChunksZ(); cz++) {
+            Chunk* chunk = world.getChunk(cx, cz);
+            if (!chunk->meshDirty || !chunk->editDirty)
+                continue;
+            chunk->meshDirty = false;
+            chunk->editDirty = false;
+            int chunkIndex = cx * world.getChunksZ() + cz;
+            editJobs.push_back(startJob(chunkIndex, *chunk));
+            editEyes.push_back(chunkEye(chunkIndex, editJobs.back().lod, sortEye));
+        }
+    }
+    if (editJobs.empty())
+        return;
+
+    // The render thread sleeps until the workers are done; at most one streaming job per
+    // worker is ahead of them
+    pool.parallelFor(static_cast<int>(editJobs.size()), [this](int i) {
+        buildMesh(editJobs[i], editEyes[i]);
+    }, true);
+    for (const MeshResult& job : editJobs)
+        uploadResult(job);
+}
+
+void ChunkRenderer::dispatch() {
+    for (int cx = 0; cx < world.getChunksX(); cx++) {
+        for (int cz = 0; cz < world.getChunksZ(); cz++) {
+            if (jobsInFlight.load() >= static_cast<int>(finished.capacity()))
+                return;
+
+            // Streaming also covers chunks whose level of detail has changed
+            Chunk* chunk = world.getChunk(cx, cz);
+            int chunkIndex = cx * world.getChunksZ() + cz;
+            if (requestedLods[chunkIndex] == wantedLods[chunkIndex] && !chunk->meshDirty)
+                continue;
+            chunk->meshDirty = false;
+            requestedLods[chunkIndex] = wantedLods[chunkIndex];
+
+            MeshResult job = startJob(chunkIndex, *chunk);
+            jobsInFlight++;
+            glm::vec3 eye = chunkEye(job.chunkIndex, job.lod, sortEye);
+            pool.submit([this, job, eye]() mutable {
+                buildMesh(job, eye);
+                // Only a job that hasn't been counted could find the queue full
+                while (!finished.tryPush(job))
+                    std::this_thread::yield();
+            });
+        }
+    }
+}
+
+MeshResult ChunkRenderer::startJob(int chunkIndex, const Chunk& chunk) {
+    MeshResult job;
+    job.chunkIndex = chunkIndex;
+    job.generation = ++generations[chunkIndex];
+    job.sortPass = sortPass;
+    job.lod = requestedLods[chunkIndex];
+    job.buffer = acquireBuffer();
+    if (job.lod == 0)
+        copyPadded(world, chunk, job.buffer->padded);
+    else
+        copySnapshot(world, chunk, 1 << job.lod, job.buffer->snapshot);
+    return job;
+}
+
+void ChunkRenderer::buildMesh(MeshResult& job, glm::vec3 eye) const {
+    MeshBuffer& buffer = *job.buffer;
+    int size = CHUNK_SIZE >> job.lod;
+    if (job.lod > 0)
+        downsample(buffer.snapshot, 1 << job.lod, buffer.padded);
+    meshChunkGreedy(buffer.padded, buffer.faces, size);
+    meshTranslucent(buffer.padded, buffer.translucent, size);
+    sortBackToFront(buffer.translucent, eye.x, eye.y, eye.z);
+    buffer.skirtQuads = appendSkirts(buffer.padded, size, buffer.faces);
+    tagChunkSlot(buffer.faces, job.chunkIndex);
+    tagChunkSlot(buffer.translucent, job.chunkIndex);
+}
+
+size_t ChunkRenderer::uploadResult(const MeshResult& result) {
+    // A newer mesh for this chunk has been requested since this one was started
+    size_t bytes = 0;
+    int i = result.chunkIndex;
+    if (result.generation == generations[i]) {
+        upload(meshes[i].opaque, *opaqueArena, result.buffer->faces);
+        upload(meshes[i].translucent, *translucentArena, result.buffer->translucent);
+        bytes = (result.buffer->faces.size() + result.buffer->translucent.size()) * sizeof(uint32_t);
+
+        // Keep the translucent faces for re-sorting
+        translucentFaces[i].swap(result.buffer->translucent);
+        transformsDirty = transformsDirty || meshes[i].lod != result.lod;
+        meshes[i].lod = result.lod;
+        meshes[i].skirtQuads = result.buffer->skirtQuads;
+        uploadedGenerations[i] = result.generation;
+        sortedPasses[i] = result.sortPass;
+    }
+    releaseBuffer(result.buffer);
+    return bytes;
+}
+
+void ChunkRenderer::waitForMeshing() {
+    // Mesh jobs stay in flight until their result is popped, so finished ones are dropped
+    // here as they come in
+    MeshResult result;
+    while (jobsInFlight.load() > 0 || sortJobsInFlight.load() > 0) {
+        while (finished.tryPop(result)) {
+            jobsInFlight--;
+            releaseBuffer(result.buffer);
+        }
+        std::this_thread::yield();
+    }
+}
+
+MeshBuffer* ChunkRenderer::acquireBuffer() {
+    if (freeBuffers.empty()) {
+        bufferStorage.push_back(std::make_unique<MeshBuffer>());
+        return bufferStorage.back().get();
+    }
+    MeshBuffer* buffer = freeBuffers.back();
+    freeBuffers.pop_back();
+    return buffer;
+}
+
+void ChunkRenderer::releaseBuffer(MeshBuffer* buffer) {
+    // Keep the capacity; the next chunk meshed into it will need about as much
+    buffer->faces.clear();
+    buffer->translucent.clear();
+    buffer->order.clear();
+    freeBuffers.push_back(buffer);
+}
+
+void ChunkRenderer::upload(MeshPart& part, QuadArena& arena, const std::vector<uint32_t>& faces) {
+    int quadCount = static_cast<int>(faces.size() / FACE_RECORD_WORDS);
+    reserveQuadIndices(quadCount);
+
+    // Most chunks have no translucent faces; they don't take any space
+    int allocation = -1;
+    if (quadCount > 0) {
+        allocation = arena.allocate(quadCount);
+        if (allocation < 0) {
+            std::cout << "No room for a chunk mesh of " << quadCount << " quads" << std::endl;
+            quadCount = 0;
+        }
+        else {
+            writeQuads(arena, allocation, faces.data(), quadCount);
+        }
+    }
+
+    arena.free(part.allocation);
+    part.allocation = allocation;
+    part.quadCount = quadCount;
+}
+
+void ChunkRenderer::reserveQuadIndices(int quads) {
+    if (quads <= quadCapacity)
+        return;
+
+    // Grow geometrically so we don't rebuild the pattern for every slightly bigger chunk
+    quadCapacity = std::max(quads, quadCapacity * 2);
+    std::vector<uint32_t> indices(quadCapacity * 6);
+    for (int q = 0; q < quadCapacity; q++) {
+        uint32_t base = q * 4;
+        indices[q * 6 + 0] = base + 0;
+        indices[q * 6 + 1] = base + 1;
+        indices[q * 6 + 2] = base + 2;
+        indices[q * 6 + 3] = base + 2;
+        indices[q * 6 + 4] = base + 3;
+        indices[q * 6 + 5] = base + 0;
+    }
+
+    glState().bindVertexArray(VAO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+}
+
+ArenaStats ChunkRenderer::getArenaStats(bool translucent) const {
+    return translucent ? translucentArena->getStats() : opaqueArena->getStats();
+}
+
+glm::mat4 ChunkRenderer::chunkModel(int chunkX, int chunkZ, int lod) const {
+    // Corner c of block i sits at (i - size / 2 + c - 0.5) * blockScale, matching the old per-cube layout
+    glm::vec3 origin(
+        chunkX * CHUNK_SIZE - world.getSizeX() / 2 - 0.5f,
+        -0.5f,
+        chunkZ * CHUNK_SIZE - world.getSizeZ() / 2 - 0.5f);
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), origin * blockScale);
+    return glm::scale(model, glm::vec3(blockScale * (1 << lod)));
+}
+
+float ChunkRenderer::chunkDistance(int chunkX, int chunkZ, glm::vec3 cameraPos) const {
+    glm::vec3 boxMin = glm::vec3(chunkModel(chunkX, chunkZ)[3]);
+    glm::vec3 boxMax = boxMin + glm::vec3(CHUNK_SIZE, CHUNK_HEIGHT, CHUNK_SIZE) * blockScale;
+    glm::vec3 closest = glm::clamp(cameraPos, boxMin, boxMax);
+    return glm::length(closest - cameraPos);
+}
+
+void ChunkRenderer::setProjection(float fovY, int viewportHeight) {
+    pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY / 2.0f));
+}
+
+float ChunkRenderer::lodDistance(int lod) const {
+    // A cell of 2^(lod + 1) blocks can misplace the surface by up to half its size
+    float error = (1 << (lod + 1)) * blockScale * 0.5f;
+    return error * pixelsPerUnit / LOD_ERROR_PIXELS;
+}
+
+int ChunkRenderer::selectLod(int chunkX, int chunkZ, glm::vec3 cameraPos) const {
+    // The level with every boundary pushed out, which is as fine as a chunk may get, and
+    // with every boundary pulled in, as coarse as it may get
+    float distance = chunkDistance(chunkX, chunkZ, cameraPos);
+    int finest = 0;
+    while (finest < MAX_LOD && distance > lodDistance(finest) * (1.0f + LOD_HYSTERESIS))
+        finest++;
+    int coarsest = 0;
+    while (coarsest < MAX_LOD && distance > lodDistance(coarsest) * (1.0f - LOD_HYSTERESIS))
+        coarsest++;
+    return std::clamp(requestedLods[chunkX * world.getChunksZ() + chunkZ], finest, coarsest);
+}
+
+bool ChunkRenderer::needsSkirts(int chunkX, int chunkZ) const {
+    int lod = meshes[chunkX * world.getChunksZ() + chunkZ].lod;
+    const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    for (const int* offset : offsets) {
+        int nx = chunkX + offset[0];
+        int nz = chunkZ + offset[1];
+        if (nx >= 0 && nx < world.getChunksX() && nz >= 0 && nz < world.getChunksZ()
+            && meshes[nx * world.getChunksZ() + nz].lod != lod)
+            return true;
+    }
+    return false;
+}
+
+void ChunkRenderer::addCommand(const MeshPart& part, const QuadArena& arena, int quadCount) {
+    // Every mesh indexes the same quad pattern from 0; the base vertex moves it to the
+    // mesh's range, and gl_VertexID / 4 comes out as the quad's place in the arena
+    commands.push_back({ static_cast<uint32_t>(quadCount * 6), 1, 0, arena.getFirst(part.allocation) * 4, 0 });
+}
+
+void ChunkRenderer::submit(const Shader& shader, const QuadArena& arena) {
+    if (commands.empty())
+        return;
+
+    shader.setInt("faces", FACE_TEXTURE_UNIT);
+    shader.setInt("chunkTransforms", CHUNK_TRANSFORM_TEXTURE_UNIT);
+    glState().bindTexture(CHUNK_TRANSFORM_TEXTURE_UNIT, GL_TEXTURE_BUFFER, transformTexture);
+    glState().bindTexture(FACE_TEXTURE_UNIT, GL_TEXTURE_BUFFER, arena.getTexture());
+    glState().bindVertexArray(VAO);
+
+    if (indirectDraws) {
+        size_t bytes = commands.size() * sizeof(DrawElementsCommand);
+        GLintptr offset = stream.write(commands.data(), bytes);
+        if (offset >= 0) {
+            glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, stream.getBuffer());
+        }
+        else {
+            offset = 0;
+            glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, bytes, commands.data(), GL_STREAM_DRAW);
+        }
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(offset),
+            static_cast<GLsizei>(commands.size()), 0);
+    }
+    else {
+        drawCounts.clear();
+        drawOffsets.clear();
+        drawBaseVertices.clear();
+        for (const DrawElementsCommand& command : commands) {
+            drawCounts.push_back(command.count);
+            drawOffsets.push_back(nullptr);
+            drawBaseVertices.push_back(command.baseVertex);
+        }
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(),
+            static_cast<GLsizei>(commands.size()), drawBaseVertices.data());
+    }
+    commands.clear();
+}
+
+void ChunkRenderer::draw(const Shader& shader, glm::vec3 cameraPos, float maxDistance, float minDistance) {
+    // Nearest chunk first, so the depth test rejects as much as possible of what is behind
+    for (auto it = drawOrder.rbegin(); it != drawOrder.rend(); ++it) {
+        int cx = *it / world.getChunksZ();
+        int cz = *it % world.getChunksZ();
+        const ChunkMesh& mesh = meshes[*it];
+        if (mesh.opaque.quadCount == 0)
+            continue;
+        float distance = chunkDistance(cx, cz, cameraPos);
+        if (distance > maxDistance || distance <= minDistance)
+            continue;
+
+        int quadCount = mesh.opaque.quadCount;
+        if (!needsSkirts(cx, cz))
+            quadCount = std::max(0, quadCount - mesh.skirtQuads);
+        if (quadCount > 0)
+            addCommand(mesh.opaque, *opaqueArena, quadCount);
+    }
+    submit(shader, *opaqueArena);
+}
+
+void ChunkRenderer::drawTranslucent(const Shader& shader, glm::vec3 cameraPos, float maxDistance, float minDistance) {
+    // Commands are drawn in order, so the far to near chunk order carries over
+    for (int chunkIndex : drawOrder) {
+        const MeshPart& part = meshes[chunkIndex].translucent;
+        if (part.quadCount == 0)
+            continue;
+        float distance = chunkDistance(chunkIndex / world.getChunksZ(), chunkIndex % world.getChunksZ(), cameraPos);
+        if (distance > maxDistance || distance <= minDistance)
+            continue;
+        addCommand(part, *translucentArena, part.quadCount);
+    }
+    submit(shader, *translucentArena);
+}
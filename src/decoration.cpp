@@ -0,0 +1,211 @@
+#include "decoration.h"
+#include "world.h"
+#include "random.h"
+#include <algorithm>
+
+// Number of darts thrown per chunk; with the spacing above this packs ~20 candidates
+const int DECORATION_ATTEMPTS = 48;
+
+// Furthest a decoration reaches from its root column
+const int DECORATION_REACH = 2;
+
+static int floorDiv(int a, int b) {
+    return (a >= 0 ? a : a - b + 1) / b;
+}
+
+void placeDecorationCandidates(Chunk& chunk, uint64_t seed) {
+    chunk.decorations.clear();
+    for (auto& row : chunk.decorationGrid)
+        std::fill(std::begin(row), std::end(row), static_cast<int16_t>(-1));
+
+    SplitMix64 rng(deriveChunkSeed(seed, chunk.chunkX, chunk.chunkZ));
+    const float spacingSq = DECORATION_SPACING * DECORATION_SPACING;
+    const int searchCells = (static_cast<int>(DECORATION_SPACING) + DECORATION_CELL - 1) / DECORATION_CELL;
+
+    for (int attempt = 0; attempt < DECORATION_ATTEMPTS; attempt++) {
+        uint64_t r = rng.next();
+        int x = static_cast<int>(r & 31);
+        int z = static_cast<int>((r >> 8) & 31);
+        int cellX = x / DECORATION_CELL;
+        int cellZ = z / DECORATION_CELL;
+
+        // Dart throwing: reject if any earlier candidate in the nearby cells is too close
+        bool free = chunk.decorationGrid[cellX][cellZ] < 0;
+        for (int gx = std::max(0, cellX - searchCells); free && gx <= std::min(DECORATION_GRID - 1, cellX + searchCells); gx++) {
+            for (int gz = std::max(0, cellZ - searchCells); gz <= std::min(DECORATION_GRID - 1, cellZ + searchCells); gz++) {
+                int index = chunk.decorationGrid[gx][gz];
+                if (index < 0)
+                    continue;
+                const Decoration& other = chunk.decorations[index];
+                float dx = static_cast<float>(other.x - (chunk.chunkX * CHUNK_SIZE + x));
+                float dz = static_cast<float>(other.z - (chunk.chunkZ * CHUNK_SIZE + z));
+                if (dx * dx + dz * dz < spacingSq) {
+                    free = false;
+                    break;
+                }
+            }
+        }
+        if (!free)
+            continue;
+
+        Decoration decoration;
+        decoration.x = chunk.chunkX * CHUNK_SIZE + x;
+        decoration.z = chunk.chunkZ * CHUNK_SIZE + z;
+        unsigned int roll = static_cast<unsigned int>((r >> 16) % 10);
+        decoration.type = roll < 6 ? DECORATION_TREE : (roll < 9 ? DECORATION_ROCK : DECORATION_RUIN);
+        decoration.priority = static_cast<uint32_t>(r >> 32);
+
+        chunk.decorationGrid[cellX][cellZ] = static_cast<int16_t>(chunk.decorations.size());
+        chunk.decorations.push_back(decoration);
+    }
+}
+
+// A candidate survives unless a higher-priority candidate within the spacing exists in
+// any chunk. This only reads the immutable candidate lists, so every chunk reaches the
+// same verdict for a given candidate without coordinating with the others.
+static bool isAccepted(const Decoration& decoration, const World& world) {
+    const float spacingSq = DECORATION_SPACING * DECORATION_SPACING;
+    const int searchCells = (static_cast<int>(DECORATION_SPACING) + DECORATION_CELL - 1) / DECORATION_CELL;
+    int cellX = floorDiv(decoration.x, DECORATION_CELL);
+    int cellZ = floorDiv(decoration.z, DECORATION_CELL);
+
+    for (int gx = cellX - searchCells; gx <= cellX + searchCells; gx++) {
+        for (int gz = cellZ - searchCells; gz <= cellZ + searchCells; gz++) {
+            const Chunk* chunk = world.getChunk(floorDiv(gx, DECORATION_GRID), floorDiv(gz, DECORATION_GRID));
+            if (chunk == nullptr)
+                continue;
+            int index = chunk->decorationGrid[gx - chunk->chunkX * DECORATION_GRID][gz - chunk->chunkZ * DECORATION_GRID];
+            if (index < 0)
+                continue;
+            const Decoration& other = chunk->decorations[index];
+            if (other.x == decoration.x && other.z == decoration.z)
+                continue;
+            float dx = static_cast<float>(other.x - decoration.x);
+            float dz = static_cast<float>(other.z - decoration.z);
+            if (dx * dx + dz * dz >= spacingSq)
+                continue;
+            bool otherWins = other.priority != decoration.priority
+                ? other.priority > decoration.priority
+                : (other.x != decoration.x ? other.x < decoration.x : other.z < decoration.z);
+            if (otherWins)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Places one block if it lands inside the chunk and the cell is empty
+static void setDecorationBlock(Chunk& chunk, int x, int y, int z, BlockType block) {
+    int localX = x - chunk.chunkX * CHUNK_SIZE;
+    int localZ = z - chunk.chunkZ * CHUNK_SIZE;
+    if (localX < 0 || localX >= CHUNK_SIZE || localZ < 0 || localZ >= CHUNK_SIZE || y < 0 || y >= CHUNK_HEIGHT)
+        return;
+    if (chunk.blocks[localX][y][localZ] == BLOCK_AIR)
+        chunk.blocks[localX][y][localZ] = block;
+}
+
+// Trunk height of a tree, 4 or 5 blocks
+static int treeTrunk(const Decoration& tree) {
+    return 4 + static_cast<int>(tree.priority & 1);
+}
+
+// Height of a tree's top layer of leaves above the ground
+static int treeTop(const Decoration& tree) {
+    return treeTrunk(tree) + 1;
+}
+
+static void stampTree(Chunk& chunk, const Decoration& tree, int ground) {
+    int trunk = treeTrunk(tree);
+    int top = treeTop(tree);
+    for (int y = 0; y < trunk; y++)
+        setDecorationBlock(chunk, tree.x, ground + y, tree.z, BLOCK_WOOD);
+
+    // Two wide layers of leaves with the corners clipped, then a narrow cap
+    for (int y = trunk - 2; y <= top; y++) {
+        int radius = y < trunk ? 2 : 1;
+        for (int dx = -radius; dx <= radius; dx++) {
+            for (int dz = -radius; dz <= radius; dz++) {
+                if (std::abs(dx) == radius && std::abs(dz) == radius && (radius == 2 || y == top))
+                    continue;
+                setDecorationBlock(chunk, tree.x + dx, ground + y, tree.z + dz, BLOCK_LEAVES);
+            }
+        }
+    }
+}
+
+static void stampRock(Chunk& chunk, const Decoration& rock, const World& world) {
+    // Up to a 2x2 boulder following the ground, with an optional block on top
+    for (int i = 0; i < 4; i++) {
+        if (i > 0 && ((rock.priority >> i) & 1) == 0)
+            continue;
+        int x = rock.x + (i & 1);
+        int z = rock.z + (i >> 1);
+        setDecorationBlock(chunk, x, world.getHeight(x, z), z, BLOCK_STONE);
+    }
+    if ((rock.priority >> 4) & 1)
+        setDecorationBlock(chunk, rock.x, world.getHeight(rock.x, rock.z) + 1, rock.z, BLOCK_STONE);
+}
+
+static void stampRuin(Chunk& chunk, const Decoration& ruin, const World& world) {
+    // Broken 5x5 ring of walls with a doorway, each wall column following the ground
+    int door = static_cast<int>(ruin.priority & 3);
+    for (int dx = -2; dx <= 2; dx++) {
+        for (int dz = -2; dz <= 2; dz++) {
+            if (std::abs(dx) != 2 && std::abs(dz) != 2)
+                continue;
+            bool doorway = (door == 0 && dz == -2 && dx == 0) || (door == 1 && dz == 2 && dx == 0)
+                || (door == 2 && dx == -2 && dz == 0) || (door == 3 && dx == 2 && dz == 0);
+            if (doorway)
+                continue;
+            int x = ruin.x + dx;
+            int z = ruin.z + dz;
+            int ground = world.getHeight(x, z);
+            int wallHeight = 1 + static_cast<int>((ruin.priority >> ((dx + 2) * 5 + (dz + 2))) & 1);
+            for (int y = 0; y < wallHeight; y++)
+                setDecorationBlock(chunk, x, ground + y, z, BLOCK_STONE);
+        }
+    }
+}
+
+void decorateChunk(Chunk& chunk, const World& world) {
+    int minX = chunk.chunkX * CHUNK_SIZE - DECORATION_REACH;
+    int maxX = (chunk.chunkX + 1) * CHUNK_SIZE - 1 + DECORATION_REACH;
+    int minZ = chunk.chunkZ * CHUNK_SIZE - DECORATION_REACH;
+    int maxZ = (chunk.chunkZ + 1) * CHUNK_SIZE - 1 + DECORATION_REACH;
+
+    for (int cx = chunk.chunkX - 1; cx <= chunk.chunkX + 1; cx++) {
+        for (int cz = chunk.chunkZ - 1; cz <= chunk.chunkZ + 1; cz++) {
+            const Chunk* source = world.getChunk(cx, cz);
+            if (source == nullptr)
+                continue;
+
+            for (const Decoration& decoration : source->decorations) {
+                if (decoration.x < minX || decoration.x > maxX || decoration.z < minZ || decoration.z > maxZ)
+                    continue;
+                if (!isAccepted(decoration, world))
+                    continue;
+
+                // Nothing is stamped under water
+                int ground = world.getHeight(decoration.x, decoration.z);
+                if (ground == 0 || ground < WATER_LEVEL)
+                    continue;
+
+                switch (decoration.type) {
+                case DECORATION_TREE:
+                    // Trees only grow on grass, not sand or steep stone, and must fit in the
+                    // chunk, leaves and all
+                    if (world.getBlock(decoration.x, ground - 1, decoration.z) == BLOCK_GRASS
+                        && ground + treeTop(decoration) < CHUNK_HEIGHT)
+                        stampTree(chunk, decoration, ground);
+                    break;
+                case DECORATION_ROCK:
+                    stampRock(chunk, decoration, world);
+                    break;
+                case DECORATION_RUIN:
+                    stampRuin(chunk, decoration, world);
+                    break;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#include "dynamic_resolution.h"
+#include "gl_state.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+DynamicResolution::DynamicResolution(int width, int height, float targetFrameTime)
+    : width(width), height(height), targetFrameTime(targetFrameTime) {
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &FBO);
+    glState().bindFramebuffer(FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Dynamic resolution framebuffer is incomplete" << std::endl;
+    glState().bindFramebuffer(0);
+}
+
+DynamicResolution::~DynamicResolution() {
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+}
+
+void DynamicResolution::update(float frameTime) {
+    // Averaged, so a single slow frame (an upload burst, a horizon refresh) doesn't count
+    // for much
+    if (averageFrameTime == 0.0f)
+        averageFrameTime = frameTime;
+    else
+        averageFrameTime += (frameTime - averageFrameTime) * FRAME_TIME_SMOOTHING;
+
+    if (++framesSinceChange < RENDER_SCALE_INTERVAL || averageFrameTime <= 0.0f)
+        return;
+    framesSinceChange = 0;
+
+    // Within 5% of the budget is close enough; chasing it closer only makes the scale hunt
+    float ratio = targetFrameTime / averageFrameTime;
+    if (ratio > 0.95f && ratio < 1.05f)
+        return;
+
+    // Fragment cost goes with the pixel count, which is the square of the scale
+    float next = scale * std::sqrt(ratio);
+    next = std::clamp(next, scale - RENDER_SCALE_STEP, scale + RENDER_SCALE_STEP);
+    scale = std::clamp(next, MIN_RENDER_SCALE, MAX_RENDER_SCALE);
+}
+
+int DynamicResolution::getWidth() const {
+    return std::max(1, static_cast<int>(std::lround(width * scale)));
+}
+
+int DynamicResolution::getHeight() const {
+    return std::max(1, static_cast<int>(std::lround(height * scale)));
+}
+
+void DynamicResolution::bind() const {
+    glState().bindFramebuffer(FBO);
+    glState().viewport(0, 0, getWidth(), getHeight());
+}
+
+void DynamicResolution::present() const {
+    glState().bindFramebuffer(0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    GLenum filter = scale < MAX_RENDER_SCALE ? GL_LINEAR : GL_NEAREST;
+    glBlitFramebuffer(0, 0, getWidth(), getHeight(), 0, 0, width, height, GL_COLOR_BUFFER_BIT, filter);
+    // Back to what the state cache thinks is bound
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
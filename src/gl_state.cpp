@@ -0,0 +1,199 @@
+#include "gl_state.h"
+
+GLState& glState() {
+    static GLState state;
+    return state;
+}
+
+int GLState::bufferSlot(GLenum target) {
+    switch (target) {
+    case GL_ARRAY_BUFFER: return 0;
+    case GL_TEXTURE_BUFFER: return 1;
+    case GL_UNIFORM_BUFFER: return 2;
+    case GL_COPY_READ_BUFFER: return 3;
+    case GL_COPY_WRITE_BUFFER: return 4;
+    case GL_DRAW_INDIRECT_BUFFER: return 5;
+    default: return -1;
+    }
+}
+
+int GLState::textureSlot(GLenum target) {
+    switch (target) {
+    case GL_TEXTURE_2D: return 0;
+    case GL_TEXTURE_2D_ARRAY: return 1;
+    case GL_TEXTURE_CUBE_MAP: return 2;
+    case GL_TEXTURE_BUFFER: return 3;
+    default: return -1;
+    }
+}
+
+int GLState::capabilitySlot(GLenum capability) {
+    switch (capability) {
+    case GL_BLEND: return 0;
+    case GL_DEPTH_TEST: return 1;
+    case GL_CULL_FACE: return 2;
+    default: return -1;
+    }
+}
+
+bool GLState::change(unsigned int& cached, unsigned int value) {
+    if (cached == value) {
+        counts.elided++;
+        return false;
+    }
+    cached = value;
+    counts.issued++;
+    return true;
+}
+
+void GLState::useProgram(unsigned int newProgram) {
+    if (change(program, newProgram))
+        glUseProgram(newProgram);
+}
+
+void GLState::bindVertexArray(unsigned int newVertexArray) {
+    if (change(vertexArray, newVertexArray))
+        glBindVertexArray(newVertexArray);
+}
+
+void GLState::bindBuffer(GLenum target, unsigned int buffer) {
+    int slot = bufferSlot(target);
+    if (slot < 0) {
+        counts.issued++;
+        glBindBuffer(target, buffer);
+    }
+    else if (change(buffers[slot], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLState::bindBufferBase(GLenum target, unsigned int index, unsigned int buffer) {
+    counts.issued++;
+    glBindBufferBase(target, index, buffer);
+    int slot = bufferSlot(target);
+    if (slot >= 0)
+        buffers[slot] = buffer;
+}
+
+void GLState::bindTexture(int unit, GLenum target, unsigned int texture) {
+    int slot = textureSlot(target);
+    if (unit >= GL_STATE_TEXTURE_UNITS || slot < 0) {
+        counts.issued += 2;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        activeUnit = unit;
+        if (unit < GL_STATE_TEXTURE_UNITS) {
+            for (unsigned int& cached : textures[unit])
+                cached = UNKNOWN;
+        }
+        return;
+    }
+    if (textures[unit][slot] == texture) {
+        counts.elided++;
+        return;
+    }
+    if (change(activeUnit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+    change(textures[unit][slot], texture);
+    glBindTexture(target, texture);
+}
+
+void GLState::bindFramebuffer(unsigned int newFramebuffer) {
+    if (change(framebuffer, newFramebuffer))
+        glBindFramebuffer(GL_FRAMEBUFFER, newFramebuffer);
+}
+
+void GLState::viewport(int x, int y, int width, int height) {
+    unsigned int rect[4] = { static_cast<unsigned int>(x), static_cast<unsigned int>(y),
+        static_cast<unsigned int>(width), static_cast<unsigned int>(height) };
+    bool same = true;
+    for (int i = 0; i < 4; i++)
+        same = same && viewportRect[i] == rect[i];
+    if (same) {
+        counts.elided++;
+        return;
+    }
+    for (int i = 0; i < 4; i++)
+        viewportRect[i] = rect[i];
+    counts.issued++;
+    glViewport(x, y, width, height);
+}
+
+void GLState::setEnabled(GLenum capability, bool enabled) {
+    int slot = capabilitySlot(capability);
+    if (slot >= 0 && !change(capabilities[slot], enabled ? 1u : 0u))
+        return;
+    if (slot < 0)
+        counts.issued++;
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void GLState::depthMask(bool write) {
+    if (change(depthWrite, write ? 1u : 0u))
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::depthFunc(GLenum func) {
+    if (change(depthTest, func))
+        glDepthFunc(func);
+}
+
+void GLState::blendFuncSeparate(GLenum sourceRGB, GLenum destinationRGB, GLenum sourceAlpha, GLenum destinationAlpha) {
+    if (blend[0] == sourceRGB && blend[1] == destinationRGB && blend[2] == sourceAlpha && blend[3] == destinationAlpha) {
+        counts.elided++;
+        return;
+    }
+    blend[0] = sourceRGB;
+    blend[1] = destinationRGB;
+    blend[2] = sourceAlpha;
+    blend[3] = destinationAlpha;
+    counts.issued++;
+    glBlendFuncSeparate(sourceRGB, destinationRGB, sourceAlpha, destinationAlpha);
+}
+
+void GLState::deleteBuffer(unsigned int buffer) {
+    glDeleteBuffers(1, &buffer);
+    for (unsigned int& cached : buffers) {
+        if (cached == buffer)
+            cached = 0;
+    }
+}
+
+void GLState::deleteTexture(unsigned int texture) {
+    glDeleteTextures(1, &texture);
+    for (auto& unit : textures) {
+        for (unsigned int& cached : unit) {
+            if (cached == texture)
+                cached = 0;
+        }
+    }
+}
+
+void GLState::invalidate() {
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    for (unsigned int& buffer : buffers)
+        buffer = UNKNOWN;
+    for (auto& unit : textures) {
+        for (unsigned int& texture : unit)
+            texture = UNKNOWN;
+    }
+    activeUnit = UNKNOWN;
+    framebuffer = UNKNOWN;
+    for (unsigned int& value : viewportRect)
+        value = UNKNOWN;
+    for (unsigned int& capability : capabilities)
+        capability = UNKNOWN;
+    depthWrite = UNKNOWN;
+    depthTest = UNKNOWN;
+    for (unsigned int& value : blend)
+        value = UNKNOWN;
+}
+
+void GLState::endFrame() {
+    lastFrame = counts;
+    counts = GLStateCounts();
+}
@@ -0,0 +1,290 @@
+#include "heightmap.h"
+#include <stb_image.h>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    bytes = static_cast<const unsigned char*>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    if (view == MAP_FAILED)
+        return;
+    // Chunks read scattered rows, so don't waste I/O on read-ahead
+    madvise(view, static_cast<size_t>(info.st_size), MADV_RANDOM);
+    bytes = static_cast<const unsigned char*>(view);
+    length = static_cast<size_t>(info.st_size);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    if (bytes == nullptr)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(bytes);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+#else
+    munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+}
+
+static std::string lowerExtension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return "";
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension;
+}
+
+HeightmapSource::HeightmapSource(const std::string& path, int worldSizeX, int worldSizeZ, const HeightmapPlacement& placement)
+    : file(lowerExtension(path) == "png" ? std::string() : path), worldSizeX(worldSizeX), worldSizeZ(worldSizeZ),
+      placement(placement) {
+    std::string extension = lowerExtension(path);
+    bool ok;
+    if (extension == "png")
+        ok = openPng(path);
+    else if (!file.isOpen()) {
+        std::cerr << "Failed to map heightmap: " << path << std::endl;
+        ok = false;
+    }
+    else if (extension == "pgm")
+        ok = openPgm();
+    else
+        ok = openRaw();
+
+    if (!ok) {
+        std::cerr << "Unsupported or corrupt heightmap: " << path << std::endl;
+        width = height = 0;
+        return;
+    }
+    if (this->placement.texelsPerColumn <= 0.0f)
+        this->placement.texelsPerColumn = 1.0f;
+    if (this->placement.centred) {
+        this->placement.originX = (width - worldSizeX * this->placement.texelsPerColumn) * 0.5f;
+        this->placement.originZ = (height - worldSizeZ * this->placement.texelsPerColumn) * 0.5f;
+    }
+    std::cout << "Heightmap " << path << ": " << width << "x" << height << ", "
+        << sourceBits << "-bit, " << this->placement.texelsPerColumn << " texels per column from ("
+        << this->placement.originX << ", " << this->placement.originZ << ")" << std::endl;
+    float spanX = worldSizeX * this->placement.texelsPerColumn;
+    float spanZ = worldSizeZ * this->placement.texelsPerColumn;
+    if (this->placement.originX < 0.0f || this->placement.originZ < 0.0f
+        || this->placement.originX + spanX > width || this->placement.originZ + spanZ > height)
+        std::cout << "The world extends past the heightmap; its edge texels are repeated (see --heightmap-scale)" << std::endl;
+}
+
+bool HeightmapSource::openRaw() {
+    if (file.size() % 2 != 0)
+        return false;
+    size_t samples = file.size() / 2;
+    int side = static_cast<int>(std::llround(std::sqrt(static_cast<double>(samples))));
+    if (static_cast<size_t>(side) * side != samples)
+        return false;
+    width = height = side;
+    bytesPerSample = 2;
+    sourceBits = 16;
+    bigEndian = false;
+    maxValue = 65535.0f;
+    pixels = file.data();
+    return true;
+}
+
+bool HeightmapSource::openPgm() {
+    const unsigned char* data = file.data();
+    size_t size = file.size();
+    if (size < 2 || data[0] != 'P' || data[1] != '5')
+        return false;
+
+    // Header: magic, width, height, maxval, separated by whitespace and # comments. Each
+    // field is bounded as it is read, so a long run of digits can't overflow.
+    size_t pos = 2;
+    long fields[3];
+    const long limits[3] = { INT_MAX, INT_MAX, 65535 };
+    for (int i = 0; i < 3; i++) {
+        long& field = fields[i];
+        while (pos < size && (std::isspace(data[pos]) || data[pos] == '#')) {
+            if (data[pos] == '#') {
+                while (pos < size && data[pos] != '\n')
+                    pos++;
+            }
+            else {
+                pos++;
+            }
+        }
+        if (pos >= size || !std::isdigit(data[pos]))
+            return false;
+        field = 0;
+        while (pos < size && std::isdigit(data[pos])) {
+            int digit = data[pos++] - '0';
+            if (field > (limits[i] - digit) / 10)
+                return false;
+            field = field * 10 + digit;
+        }
+    }
+    // Exactly one whitespace byte separates the header from the samples
+    if (pos >= size || !std::isspace(data[pos]))
+        return false;
+    pos++;
+
+    width = static_cast<int>(fields[0]);
+    height = static_cast<int>(fields[1]);
+    long maxval = fields[2];
+    if (width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535)
+        return false;
+    bytesPerSample = maxval > 255 ? 2 : 1;
+    sourceBits = bytesPerSample * 8;
+    bigEndian = true; // PGM stores 16-bit samples most significant byte first
+    maxValue = static_cast<float>(maxval);
+    if (pos + static_cast<size_t>(width) * height * bytesPerSample > size)
+        return false;
+    pixels = data + pos;
+    return true;
+}
+
+bool HeightmapSource::openPng(const std::string& path) {
+    std::cout << "PNG heightmaps are compressed and will be decoded into memory: " << path << std::endl;
+    sourceBits = stbi_is_16_bit(path.c_str()) ? 16 : 8;
+    int components;
+    stbi_us* data = stbi_load_16(path.c_str(), &width, &height, &components, 1);
+    if (data == nullptr)
+        return false;
+    decoded.assign(data, data + static_cast<size_t>(width) * height);
+    stbi_image_free(data);
+    bytesPerSample = 2;
+    maxValue = 65535.0f;
+    return true;
+}
+
+float HeightmapSource::pixel(int px, int py) const {
+    px = std::clamp(px, 0, width - 1);
+    py = std::clamp(py, 0, height - 1);
+    size_t index = static_cast<size_t>(py) * width + px;
+
+    if (!decoded.empty())
+        return decoded[index] / maxValue;
+
+    if (bytesPerSample == 1)
+        return pixels[index] / maxValue;
+
+    const unsigned char* sample = pixels + index * 2;
+    unsigned int value = bigEndian ? (sample[0] << 8) | sample[1] : (sample[1] << 8) | sample[0];
+    return value / maxValue;
+}
+
+float HeightmapSource::bilinear(float u, float v) const {
+    float fu = std::floor(u);
+    float fv = std::floor(v);
+    int px = static_cast<int>(fu);
+    int py = static_cast<int>(fv);
+    float fx = u - fu;
+    float fz = v - fv;
+
+    float top = pixel(px, py) + fx * (pixel(px + 1, py) - pixel(px, py));
+    float bottom = pixel(px, py + 1) + fx * (pixel(px + 1, py + 1) - pixel(px, py + 1));
+    return top + fz * (bottom - top);
+}
+
+float HeightmapSource::resample(int x, int z, int columns) const {
+    // Image position of the column centre
+    float scale = placement.texelsPerColumn;
+    float u = placement.originX + (x + 0.5f) * scale - 0.5f;
+    float v = placement.originZ + (z + 0.5f) * scale - 0.5f;
+    float footprint = scale * columns;
+    if (footprint <= 1.0f)
+        return bilinear(u, v);
+
+    // Box filter, so decimating the image doesn't alias. Up to MAX_FILTER_TAPS texels a side
+    // every texel is read; beyond that each tap is bilinear between texels and averages a
+    // 2x2 block, which keeps it exact up to twice that.
+    int taps = std::min(MAX_FILTER_TAPS, static_cast<int>(std::ceil(footprint)));
+    float spacing = footprint / taps;
+    float start = (spacing - footprint) * 0.5f;
+    float sum = 0.0f;
+    for (int i = 0; i < taps; i++) {
+        for (int j = 0; j < taps; j++) {
+            float tapU = u + start + i * spacing;
+            float tapV = v + start + j * spacing;
+            if (spacing <= 1.0f)
+                sum += pixel(static_cast<int>(std::lround(tapU)), static_cast<int>(std::lround(tapV)));
+            else
+                sum += bilinear(tapU, tapV);
+        }
+    }
+    return sum / (taps * taps);
+}
+
+void HeightmapSource::sampleHeights(int x0, int z0, int sampleWidth, int sampleDepth, int* out, float* slopes) const {
+    // Values with a one column border, for the differences at the edges
+    const int borderDepth = sampleDepth + 2;
+    std::vector<float> values((sampleWidth + 2) * borderDepth);
+    for (int x = 0; x < sampleWidth + 2; x++) {
+        for (int z = 0; z < borderDepth; z++)
+            values[x * borderDepth + z] = std::clamp(resample(x0 + x - 1, z0 + z - 1, 1), 0.0f, 1.0f);
+    }
+
+    for (int x = 0; x < sampleWidth; x++) {
+        for (int z = 0; z < sampleDepth; z++) {
+            const float* centre = &values[(x + 1) * borderDepth + (z + 1)];
+            out[x * sampleDepth + z] = static_cast<int>(*centre * MAX_HEIGHT);
+            float dx = (centre[borderDepth] - centre[-borderDepth]) * 0.5f;
+            float dz = (centre[1] - centre[-1]) * 0.5f;
+            slopes[x * sampleDepth + z] = std::sqrt(dx * dx + dz * dz) * MAX_HEIGHT;
+        }
+    }
+}
+
+float HeightmapSource::sampleCoarseHeight(int x, int z, int step) const {
+    // One filtered sample stands for the step x step columns around it, so it reads a
+    // capped number of texels however many the fine pass would
+    return std::clamp(resample(x, z, step), 0.0f, 1.0f) * MAX_HEIGHT;
+}
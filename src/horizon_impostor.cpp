@@ -0,0 +1,144 @@
+#include "horizon_impostor.h"
+#include "gl_state.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <cmath>
+
+// Direction and up vector of each cubemap face, in GL_TEXTURE_CUBE_MAP_POSITIVE_X order
+static const glm::vec3 FACE_DIRECTIONS[6][2] = {
+    { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) },
+    { glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) },
+    { glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) },
+    { glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+    { glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f) },
+    { glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f) }
+};
+
+HorizonImpostor::HorizonImpostor(int resolution) : resolution(resolution) {
+    glGenTextures(2, cubemaps);
+    for (unsigned int cubemap : cubemaps) {
+        glState().bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemap);
+        for (int face = 0; face < 6; face++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, resolution, resolution, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    glState().bindTexture(0, GL_TEXTURE_CUBE_MAP, 0);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, resolution, resolution);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &FBO);
+    glState().bindFramebuffer(FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, cubemaps[0], 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Horizon impostor framebuffer is incomplete" << std::endl;
+    glState().bindFramebuffer(0);
+
+    // A unit cube around the camera; only its directions matter
+    float vertices[] = {
+        -1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,   1.0f, -1.0f, -1.0f,
+         1.0f,  1.0f, -1.0f,  -1.0f, -1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f,  1.0f,  1.0f,
+         1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,
+        -1.0f,  1.0f,  1.0f,  -1.0f,  1.0f, -1.0f,  -1.0f, -1.0f, -1.0f,
+        -1.0f, -1.0f, -1.0f,  -1.0f, -1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,
+         1.0f,  1.0f,  1.0f,   1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,
+         1.0f, -1.0f, -1.0f,   1.0f,  1.0f,  1.0f,   1.0f, -1.0f,  1.0f,
+        -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f, -1.0f,  1.0f,
+         1.0f, -1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,  -1.0f, -1.0f, -1.0f,
+        -1.0f,  1.0f, -1.0f,   1.0f,  1.0f,  1.0f,   1.0f,  1.0f, -1.0f,
+         1.0f,  1.0f,  1.0f,  -1.0f,  1.0f, -1.0f,  -1.0f,  1.0f,  1.0f
+    };
+    glGenVertexArrays(1, &cubeVAO);
+    glGenBuffers(1, &cubeVBO);
+    glState().bindVertexArray(cubeVAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glState().bindVertexArray(0);
+}
+
+HorizonImpostor::~HorizonImpostor() {
+    glDeleteVertexArrays(1, &cubeVAO);
+    glDeleteBuffers(1, &cubeVBO);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glState().deleteTexture(cubemaps[0]);
+    glState().deleteTexture(cubemaps[1]);
+}
+
+bool HorizonImpostor::needsRefresh(glm::vec3 cameraPos, float sunAngle) const {
+    return refreshing || !captured || glm::length(cameraPos - capturePos) > HORIZON_REFRESH_DISTANCE
+        || std::abs(sunAngle - captureSunAngle) >= HORIZON_REFRESH_ANGLE;
+}
+
+void HorizonImpostor::refresh(glm::vec3 cameraPos, float sunAngle, float farPlane,
+    const std::function<void(glm::vec3 eye, const glm::mat4& view, const glm::mat4& projection)>& drawScene) {
+    if (!refreshing) {
+        refreshing = true;
+        nextFace = 0;
+        refreshPos = cameraPos;
+        refreshSunAngle = sunAngle;
+    }
+    int lastFace = captured ? nextFace + 1 : 6;
+
+    // Ninety degrees per face, so the six frusta tile the whole sphere
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, farPlane);
+
+    // Cleared to transparent rather than the sky colour, which changes between refreshes
+    float clearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    glState().bindFramebuffer(FBO);
+    glState().viewport(0, 0, resolution, resolution);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    for (int face = nextFace; face < lastFace; face++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubemaps[1 - front], 0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glm::mat4 view = glm::lookAt(refreshPos, refreshPos + FACE_DIRECTIONS[face][0], FACE_DIRECTIONS[face][1]);
+        drawScene(refreshPos, view, projection);
+    }
+    glState().bindFramebuffer(0);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    nextFace = lastFace;
+
+    // All six faces are in, so the new capture replaces the one being drawn
+    if (nextFace == 6) {
+        front = 1 - front;
+        refreshing = false;
+        captured = true;
+        capturePos = refreshPos;
+        captureSunAngle = refreshSunAngle;
+    }
+}
+
+void HorizonImpostor::draw(Shader& shader, const glm::mat4& view, const glm::mat4& projection) {
+    if (!captured)
+        return;
+
+    shader.use();
+    // Rotation only, so the cube stays centred on the camera
+    shader.setMat4("view", glm::mat4(glm::mat3(view)));
+    shader.setMat4("projection", projection);
+    shader.setInt("horizon", HORIZON_TEXTURE_UNIT);
+    glState().bindTexture(HORIZON_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP, cubemaps[front]);
+
+    // Blended over the sky at the far plane, so it never covers anything nearer
+    glState().setEnabled(GL_BLEND, true);
+    glState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glState().depthMask(false);
+    glState().depthFunc(GL_LEQUAL);
+    glState().bindVertexArray(cubeVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glState().depthFunc(GL_LESS);
+    glState().depthMask(true);
+    glState().setEnabled(GL_BLEND, false);
+}
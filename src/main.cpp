@@ -6,17 +6,65 @@
 #include "shader.h"
 #include "camera.h"
 #include "perlin_noise.h"
+#include "terrain.h"
+#include "heightmap.h"
+#include "world.h"
+#include "thread_pool.h"
+#include "random.h"
+#include "chunk_renderer.h"
+#include "horizon_impostor.h"
+#include "mesher.h"
+#include "frame_uniforms.h"
+#include "render_queue.h"
+#include "gl_state.h"
+#include "dynamic_resolution.h"
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <chrono>
 #include <stb_image.h>
 
 // settings
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
 const unsigned int SHADOW_WIDTH = 2048, SHADOW_HEIGHT = 2048;
-const float RENDER_DISTANCE = 16.0f; // Render distance in blocks
-const int TERRAIN_SIZE = 100;
-const int MAX_HEIGHT = 24;
+
+// Ways the terrain shader can filter the shadow map, the same values as shadowKernel in
+// fragment_shader.fs. Every tap is a hardware-filtered 2x2 comparison.
+enum ShadowKernel {
+    SHADOW_KERNEL_1_TAP,
+    SHADOW_KERNEL_4_TAP,
+    SHADOW_KERNEL_9_TAP,
+    SHADOW_KERNEL_POISSON
+};
+
+struct ShadowQuality {
+    const char* name;
+    ShadowKernel kernel;
+    float radius; // Spacing of the taps, in shadow map texels
+};
+
+// Chosen with --shadows or F1 to F4
+const ShadowQuality SHADOW_PRESETS[] = {
+    { "low", SHADOW_KERNEL_1_TAP, 1.0f },
+    { "medium", SHADOW_KERNEL_4_TAP, 1.0f },
+    { "high", SHADOW_KERNEL_9_TAP, 1.0f },
+    { "ultra", SHADOW_KERNEL_POISSON, 2.0f }
+};
+const int SHADOW_PRESET_COUNT = sizeof(SHADOW_PRESETS) / sizeof(SHADOW_PRESETS[0]);
+const float RENDER_DISTANCE = 192.0f; // Render distance in world units, enough for the whole world
+const float SHADOW_DISTANCE = 48.0f; // Chunks within this distance of the camera cast shadows
+const float IMPOSTOR_DISTANCE = 96.0f; // Chunks farther than this are drawn into the horizon impostor
+const int HORIZON_RESOLUTION = 512; // Side of each horizon cubemap face in texels
+const float ARENA_STATS_INTERVAL = 10.0f; // Seconds between mesh arena reports
+const float DEFAULT_TARGET_FPS = 60.0f; // Frame rate the render scale adapts to hold
+const int WORLD_CHUNKS = 16; // World is WORLD_CHUNKS x WORLD_CHUNKS chunks
+const int TERRAIN_SIZE = WORLD_CHUNKS * CHUNK_SIZE;
+
+// Note to marker: Change directory according to your file's local location
+const std::string RESOURCE_DIR = "C:/Users/USER/OneDrive - UNIVERSITAS INDONESIA/University of Queensland/Semester 1 2024/COSC3000/Assessment/Major Project/Project/MinecraftTerrain/";
 
 // camera
 Camera camera(glm::vec3(0.0f, 7.0f, 3.0f));
@@ -25,6 +73,20 @@ Camera camera(glm::vec3(0.0f, 7.0f, 3.0f));
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// Block edits requested by mouse clicks since the last frame
+const float EDIT_REACH = 16.0f; // How far away blocks can be edited, in blocks
+const int EDIT_BRUSH_RADIUS = 3; // Radius of shift-click edits, in blocks
+bool breakRequested = false;
+bool placeRequested = false;
+bool brushRequested = false;
+uint8_t placeBlock = BLOCK_STONE; // Chosen with the number keys
+
+// Lay down the depth of the opaque terrain before shading it, so each pixel is shaded once
+bool depthPrepass = false;
+
+// Index into SHADOW_PRESETS
+int shadowPreset = 1;
+
 // process all input
 void processInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -38,6 +100,26 @@ void processInput(GLFWwindow* window) {
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    // 1 places stone, 2 glass
+    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
+        placeBlock = BLOCK_STONE;
+    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
+        placeBlock = BLOCK_GLASS;
+
+    // P turns the depth prepass on, O off
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
+        depthPrepass = true;
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS)
+        depthPrepass = false;
+
+    // F1 to F4 pick the shadow quality, lowest first
+    for (int i = 0; i < SHADOW_PRESET_COUNT; i++) {
+        if (glfwGetKey(window, GLFW_KEY_F1 + i) == GLFW_PRESS && shadowPreset != i) {
+            shadowPreset = i;
+            std::cout << "Shadow quality: " << SHADOW_PRESETS[i].name << std::endl;
+        }
+    }
 }
 
 // callback function for mouse movement
@@ -66,6 +148,44 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
     camera.ProcessMouseScroll(yoffset);
 }
 
+// Left click breaks the block under the crosshair, right click places the selected block
+// against it.
+// Holding shift edits a whole sphere of blocks at once.
+void mouse_button_callback(GLFWwindow*, int button, int action, int mods) {
+    if (action != GLFW_PRESS)
+        return;
+    if (button == GLFW_MOUSE_BUTTON_LEFT)
+        breakRequested = true;
+    else if (button == GLFW_MOUSE_BUTTON_RIGHT)
+        placeRequested = true;
+    brushRequested = (mods & GLFW_MOD_SHIFT) != 0;
+}
+
+// Turn this frame's clicks into queued world edits
+void queueClickEdits(World& world, float blockScale) {
+    if (!breakRequested && !placeRequested)
+        return;
+
+    // World positions to block units, where block (i, k, j) spans [i, i + 1) and so on
+    glm::vec3 origin = camera.Position / blockScale + glm::vec3(world.getSizeX() / 2 + 0.5f, 0.5f, world.getSizeZ() / 2 + 0.5f);
+    glm::ivec3 hit, before;
+    if (world.raycast(origin, camera.Front, EDIT_REACH, hit, before)) {
+        glm::ivec3 centre = breakRequested ? hit : before;
+        uint8_t block = breakRequested ? static_cast<uint8_t>(BLOCK_AIR) : placeBlock;
+        int radius = brushRequested ? EDIT_BRUSH_RADIUS : 0;
+        for (int dx = -radius; dx <= radius; dx++) {
+            for (int dy = -radius; dy <= radius; dy++) {
+                for (int dz = -radius; dz <= radius; dz++) {
+                    if (dx * dx + dy * dy + dz * dz <= radius * radius)
+                        world.queueEdit(centre.x + dx, centre.y + dy, centre.z + dz, block);
+                }
+            }
+        }
+    }
+    breakRequested = false;
+    placeRequested = false;
+}
+
 unsigned int loadTexture(const char* path) {
     unsigned int textureID;
     glGenTextures(1, &textureID);
@@ -81,7 +201,7 @@ unsigned int loadTexture(const char* path) {
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        glState().bindTexture(0, GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -100,8 +220,48 @@ unsigned int loadTexture(const char* path) {
     return textureID;
 }
 
+// Load same-sized images into the layers of one array texture, so chunk meshes can pick
+// a texture per face without switching bindings
+unsigned int loadTextureArray(const std::vector<std::string>& paths) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glState().bindTexture(0, GL_TEXTURE_2D_ARRAY, textureID);
+
+    int layerWidth = 0, layerHeight = 0;
+    for (size_t layer = 0; layer < paths.size(); layer++) {
+        int width, height, nrComponents;
+        unsigned char* data = stbi_load(paths[layer].c_str(), &width, &height, &nrComponents, 3);
+        if (!data) {
+            std::cout << "Failed to load texture " << paths[layer] << std::endl;
+            continue;
+        }
+        if (layerWidth == 0) {
+            layerWidth = width;
+            layerHeight = height;
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8, width, height, static_cast<GLsizei>(paths.size()), 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        }
+        if (width == layerWidth && height == layerHeight) {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer), width, height, 1, GL_RGB, GL_UNSIGNED_BYTE, data);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+        else {
+            std::cout << "Texture " << paths[layer] << " is " << width << "x" << height << ", expected "
+                << layerWidth << "x" << layerHeight << std::endl;
+        }
+        stbi_image_free(data);
+    }
+
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-void renderSun(Shader& shader, unsigned int VAO, glm::vec3 lightPos, glm::mat4 view, glm::mat4 projection) {
+    return textureID;
+}
+
+void renderSun(Shader& shader, unsigned int VAO, glm::vec3 lightPos) {
     shader.use();
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, lightPos);
@@ -118,21 +278,22 @@ void renderSun(Shader& shader, unsigned int VAO, glm::vec3 lightPos, glm::mat4 v
     model = glm::rotate(model, angle, axis);
 
     shader.setMat4("model", model);
-    shader.setMat4("projection", projection);
-    shader.setMat4("view", view);
-
-    shader.setInt("isSun", 1); // Set isSun to true for rendering the sun
 
-    glBindVertexArray(VAO);
+    glState().bindVertexArray(VAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
+}
 
-    shader.setInt("isSun", 0); // Reset isSun to false after rendering the sun
+// Write the frame's uniforms to the shared block
+void writeFrameUniforms(unsigned int UBO, const FrameUniforms& uniforms) {
+    glState().bindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &uniforms);
 }
 
-// Perlin noise parameters
-const int OCTAVES = 4;
-const float FREQUENCY = 0.02f;
-const float PERSISTENCE = 0.5f;
+void printArenaStats(const char* name, const ArenaStats& stats) {
+    std::cout << name << " arena: " << stats.used << "/" << stats.capacity << " quads in " << stats.allocations
+        << " meshes, occupancy " << stats.occupancy() * 100.0f << "%, fragmentation " << stats.fragmentation() * 100.0f
+        << "%, " << stats.movedQuads << " quads moved, " << stats.grows << " grows, " << stats.shrinks << " shrinks" << std::endl;
+}
 
 float lerp(float a, float b, float t) {
     return a + t * (b - a);
@@ -146,49 +307,6 @@ float smoothStep(float t) {
     return t * t * (3 - 2 * t);
 }
 
-float perlinNoise(float x, float y, PerlinNoise& perlin) {
-    float total = 0.0f;
-    float frequency = FREQUENCY;
-    float amplitude = 1.0f;
-    float maxValue = 0.0f;
-
-    for (int i = 0; i < OCTAVES; i++) {
-        total += perlin.noise(x * frequency, y * frequency) * amplitude;
-        maxValue += amplitude;
-        frequency *= 2.0f;
-        amplitude *= PERSISTENCE;
-    }
-
-    return total / maxValue;
-}
-
-void smoothTerrain(std::vector<std::vector<int>>& terrainHeights) {
-    std::vector<std::vector<int>> smoothedHeights(TERRAIN_SIZE, std::vector<int>(TERRAIN_SIZE));
-
-    for (int i = 0; i < TERRAIN_SIZE; i++) {
-        for (int j = 0; j < TERRAIN_SIZE; j++) {
-            int sum = 0;
-            int count = 0;
-
-            for (int x = -1; x <= 1; x++) {
-                for (int y = -1; y <= 1; y++) {
-                    int neighborX = i + x;
-                    int neighborY = j + y;
-
-                    if (neighborX >= 0 && neighborX < TERRAIN_SIZE && neighborY >= 0 && neighborY < TERRAIN_SIZE) {
-                        sum += terrainHeights[neighborX][neighborY];
-                        count++;
-                    }
-                }
-            }
-
-            smoothedHeights[i][j] = sum / count;
-        }
-    }
-
-    terrainHeights = smoothedHeights;
-}
-
 glm::vec3 calculateSkyColor(float sunY, float radius) {
     glm::vec3 nightColor(0.0f, 0.0f, 0.0f); // Dark
     glm::vec3 noonColor(0.5f, 0.6f, 0.7f); // Light blue
@@ -224,7 +342,282 @@ glm::vec3 calculateSkyColor(float sunY, float radius) {
 }
 
 
-int main() {
+// Heights from an imported heightmap if one was given, otherwise from noise
+std::unique_ptr<HeightSource> createHeightSource(const std::string& heightmapPath, const HeightmapPlacement& placement,
+    const PerlinNoise& perlin, const World& world) {
+    if (!heightmapPath.empty()) {
+        auto heightmap = std::make_unique<HeightmapSource>(heightmapPath, world.getSizeX(), world.getSizeZ(), placement);
+        if (heightmap->isValid())
+            return heightmap;
+        std::cout << "Falling back to procedural terrain" << std::endl;
+    }
+    return std::make_unique<NoiseHeightSource>(perlin);
+}
+
+// Generate the same region with one worker and with `threads` workers and compare every
+// chunk hash. Returns the process exit code: 0 when the runs are bit-identical.
+int verifyDeterminism(const std::string& heightmapPath, const HeightmapPlacement& placement, uint64_t seed, unsigned int threads) {
+    const int regionChunks = 8;
+    PerlinNoise perlin(seed);
+
+    World serialWorld(regionChunks, regionChunks, seed);
+    std::unique_ptr<HeightSource> serialSource = createHeightSource(heightmapPath, placement, perlin, serialWorld);
+    ThreadPool serialPool(1);
+    serialWorld.generate(*serialSource, serialPool);
+
+    World parallelWorld(regionChunks, regionChunks, seed);
+    std::unique_ptr<HeightSource> parallelSource = createHeightSource(heightmapPath, placement, perlin, parallelWorld);
+    ThreadPool parallelPool(threads);
+    parallelWorld.generate(*parallelSource, parallelPool);
+
+    int mismatches = 0;
+    for (int cx = 0; cx < regionChunks; cx++) {
+        for (int cz = 0; cz < regionChunks; cz++) {
+            uint64_t expected = serialWorld.hashChunk(cx, cz);
+            uint64_t actual = parallelWorld.hashChunk(cx, cz);
+            if (expected != actual) {
+                std::cout << "Chunk (" << cx << ", " << cz << ") differs: " << std::hex << expected
+                    << " vs " << actual << std::dec << std::endl;
+                mismatches++;
+            }
+        }
+    }
+
+    std::cout << "Determinism check, seed " << seed << ", 1 vs " << parallelPool.size() << " threads: "
+        << (regionChunks * regionChunks - mismatches) << "/" << regionChunks * regionChunks
+        << " chunks identical" << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+// Compare the analytic derivatives of PerlinNoise::noise and of the fBm heights with
+// central differences at random points. Returns the process exit code: 0 when they agree.
+int verifyNoiseGradient(uint64_t seed) {
+    const int samples = 10000;
+    PerlinNoise perlin(seed);
+    SplitMix64 rng(seed);
+    auto coordinate = [&](double range) {
+        return static_cast<double>(rng.next() >> 11) / static_cast<double>(1ull << 53) * range;
+    };
+
+    int failures = 0;
+    double largestNoiseError = 0.0;
+    double largestHeightError = 0.0;
+    for (int i = 0; i < samples; i++) {
+        // Raw noise, in double precision: the derivative is of order 1 per unit
+        double x = coordinate(256.0);
+        double y = coordinate(256.0);
+        const double h = 1e-5;
+        double dx, dy;
+        double value = perlin.noise(x, y, dx, dy);
+        double expectedX = (perlin.noise(x + h, y) - perlin.noise(x - h, y)) / (2.0 * h);
+        double expectedY = (perlin.noise(x, y + h) - perlin.noise(x, y - h)) / (2.0 * h);
+        double noiseError = std::max(std::abs(dx - expectedX), std::abs(dy - expectedY));
+        largestNoiseError = std::max(largestNoiseError, noiseError);
+
+        // fBm heights, in float, over a step of a tenth of a column. In blocks per column,
+        // as the steep slope rule reads them.
+        float columnX = static_cast<float>(coordinate(1024.0));
+        float columnZ = static_cast<float>(coordinate(1024.0));
+        const float step = 0.1f;
+        glm::vec2 gradient;
+        perlinNoise(columnX, columnZ, perlin, gradient);
+        glm::vec2 expected(
+            perlinNoise(columnX + step, columnZ, perlin) - perlinNoise(columnX - step, columnZ, perlin),
+            perlinNoise(columnX, columnZ + step, perlin) - perlinNoise(columnX, columnZ - step, perlin));
+        expected /= 2.0f * step;
+        double heightError = glm::length(gradient - expected) * MAX_HEIGHT;
+        largestHeightError = std::max(largestHeightError, heightError);
+
+        if (value != perlin.noise(x, y) || noiseError > 1e-6 || heightError > 1e-2)
+            failures++;
+    }
+
+    std::cout << "Noise gradient check, seed " << seed << ": " << (samples - failures) << "/" << samples
+        << " samples match finite differences (largest error " << largestNoiseError << " per unit of noise, "
+        << largestHeightError << " blocks per column of height)" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+// Expand merged quads back into the word 0 of every unit face they cover, so greedy
+// output can be compared face by face with the reference mesher
+std::vector<uint32_t> expandQuads(const std::vector<uint32_t>& quads) {
+    std::vector<uint32_t> unitFaces;
+    for (size_t i = 0; i < quads.size(); i += FACE_RECORD_WORDS) {
+        uint32_t record = quads[i];
+        uint32_t face = (record >> 15) & 7;
+        int n = face / 2 == 0 ? 2 : (face / 2 == 1 ? 0 : 1);
+        int position[3] = { static_cast<int>(record & 31), static_cast<int>((record >> 5) & 31), static_cast<int>((record >> 10) & 31) };
+        int width = (quads[i + 1] & 31) + 1;
+        int height = ((quads[i + 1] >> 5) & 31) + 1;
+        for (int a = 0; a < width; a++) {
+            for (int b = 0; b < height; b++) {
+                int unit[3] = { position[0], position[1], position[2] };
+                unit[(n + 1) % 3] += a;
+                unit[(n + 2) % 3] += b;
+                unitFaces.push_back((record & ~0x7FFFu) | unit[0] | (unit[1] << 5) | (unit[2] << 10));
+            }
+        }
+    }
+    std::sort(unitFaces.begin(), unitFaces.end());
+    return unitFaces;
+}
+
+// Time the reference and greedy meshers over every chunk of a generated world and check
+// that both produce the same faces. Returns the process exit code.
+int benchmarkMeshers(const std::string& heightmapPath, const HeightmapPlacement& placement, uint64_t seed, unsigned int threads) {
+    const int rounds = 20;
+    PerlinNoise perlin(seed);
+    World world(WORLD_CHUNKS, WORLD_CHUNKS, seed);
+    std::unique_ptr<HeightSource> source = createHeightSource(heightmapPath, placement, perlin, world);
+    ThreadPool pool(threads);
+    world.generate(*source, pool);
+
+    // Padded snapshots of every chunk, so the meshers are timed on their own
+    int chunkCount = world.getChunksX() * world.getChunksZ();
+    std::vector<PaddedChunk> padded(chunkCount);
+    auto copyStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < chunkCount; i++)
+        copyPadded(world, *world.getChunk(i / world.getChunksZ(), i % world.getChunksZ()), padded[i]);
+    auto copyEnd = std::chrono::steady_clock::now();
+    std::cout << "padded copy: " << std::chrono::duration<double, std::micro>(copyEnd - copyStart).count() / chunkCount
+        << " us per chunk" << std::endl;
+
+    struct Mesher {
+        const char* name;
+        void (*mesh)(const PaddedChunk&, std::vector<uint32_t>&);
+    };
+    const Mesher meshers[] = {
+        { "face culling", meshChunk },
+        { "binary greedy", [](const PaddedChunk& chunk, std::vector<uint32_t>& faces) { meshChunkGreedy(chunk, faces); } }
+    };
+
+    std::vector<uint32_t> faces;
+    for (const Mesher& mesher : meshers) {
+        size_t quads = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++) {
+            for (int i = 0; i < chunkCount; i++) {
+                mesher.mesh(padded[i], faces);
+                quads += faces.size() / FACE_RECORD_WORDS;
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        int meshed = rounds * chunkCount;
+        std::cout << mesher.name << ": " << std::chrono::duration<double, std::micro>(end - start).count() / meshed
+            << " us per chunk, " << quads / meshed << " quads per chunk" << std::endl;
+    }
+
+    // Translucent faces are meshed separately, then sorted for an eye above the chunk
+    size_t translucentQuads = 0;
+    auto translucentStart = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < chunkCount; i++) {
+            meshTranslucent(padded[i], faces);
+            sortBackToFront(faces, CHUNK_SIZE / 2.0f, CHUNK_HEIGHT, CHUNK_SIZE / 2.0f);
+            translucentQuads += faces.size() / FACE_RECORD_WORDS;
+        }
+    }
+    auto translucentEnd = std::chrono::steady_clock::now();
+    std::cout << "translucent + sort: " << std::chrono::duration<double, std::micro>(translucentEnd - translucentStart).count() / (rounds * chunkCount)
+        << " us per chunk, " << translucentQuads / (rounds * chunkCount) << " quads per chunk" << std::endl;
+
+    // Each coarser level of detail. The snapshot is the part that runs on the render thread;
+    // downsampling and meshing run on the workers.
+    PaddedChunk cells;
+    std::unique_ptr<ChunkSnapshot> snapshot = std::make_unique<ChunkSnapshot>();
+    for (int lod = 1; lod <= MAX_LOD; lod++) {
+        size_t lodQuads = 0;
+        size_t skirtQuads = 0;
+        std::chrono::steady_clock::duration copying{};
+        std::chrono::steady_clock::duration downsampling{};
+        std::chrono::steady_clock::duration meshing{};
+        for (int i = 0; i < chunkCount; i++) {
+            auto start = std::chrono::steady_clock::now();
+            copySnapshot(world, *world.getChunk(i / world.getChunksZ(), i % world.getChunksZ()), 1 << lod, *snapshot);
+            auto copied = std::chrono::steady_clock::now();
+            downsample(*snapshot, 1 << lod, cells);
+            auto downsampled = std::chrono::steady_clock::now();
+            meshChunkGreedy(cells, faces, CHUNK_SIZE >> lod);
+            lodQuads += faces.size() / FACE_RECORD_WORDS;
+            skirtQuads += appendSkirts(cells, CHUNK_SIZE >> lod, faces);
+            copying += copied - start;
+            downsampling += downsampled - copied;
+            meshing += std::chrono::steady_clock::now() - downsampled;
+        }
+        std::cout << "lod " << lod << ": snapshot " << std::chrono::duration<double, std::micro>(copying).count() / chunkCount
+            << " us, downsample " << std::chrono::duration<double, std::micro>(downsampling).count() / chunkCount
+            << " us, mesh " << std::chrono::duration<double, std::micro>(meshing).count() / chunkCount << " us per chunk, "
+            << lodQuads / chunkCount << " quads + " << skirtQuads / chunkCount << " skirt quads per chunk" << std::endl;
+    }
+
+    int mismatches = 0;
+    std::vector<uint32_t> reference;
+    for (int i = 0; i < chunkCount; i++) {
+        meshChunk(padded[i], reference);
+        meshChunkGreedy(padded[i], faces);
+        if (expandQuads(reference) != expandQuads(faces))
+            mismatches++;
+    }
+    std::cout << "Greedy meshes cover the reference faces in " << (chunkCount - mismatches)
+        << "/" << chunkCount << " chunks" << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    std::string heightmapPath;
+    HeightmapPlacement placement;
+    uint64_t seed = DEFAULT_WORLD_SEED;
+    bool verify = false;
+    bool verifyNoise = false;
+    bool benchmark = false;
+    unsigned int threads = std::thread::hardware_concurrency();
+    float targetFps = DEFAULT_TARGET_FPS;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--heightmap" && i + 1 < argc)
+            heightmapPath = argv[++i];
+        else if (arg == "--heightmap-scale" && i + 1 < argc)
+            placement.texelsPerColumn = std::stof(argv[++i]);
+        else if (arg == "--heightmap-origin" && i + 2 < argc) {
+            placement.centred = false;
+            placement.originX = std::stof(argv[++i]);
+            placement.originZ = std::stof(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+            seed = std::stoull(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = static_cast<unsigned int>(std::stoul(argv[++i]));
+        else if (arg == "--verify-determinism")
+            verify = true;
+        else if (arg == "--verify-noise")
+            verifyNoise = true;
+        else if (arg == "--bench-mesher")
+            benchmark = true;
+        else if (arg == "--target-fps" && i + 1 < argc)
+            targetFps = std::max(1.0f, std::stof(argv[++i]));
+        else if (arg == "--shadows" && i + 1 < argc) {
+            std::string name = argv[++i];
+            bool found = false;
+            for (int preset = 0; preset < SHADOW_PRESET_COUNT; preset++) {
+                if (name == SHADOW_PRESETS[preset].name) {
+                    shadowPreset = preset;
+                    found = true;
+                }
+            }
+            if (!found)
+                std::cout << "Unknown shadow quality " << name << ", using " << SHADOW_PRESETS[shadowPreset].name << std::endl;
+        }
+    }
+
+    if (benchmark)
+        return benchmarkMeshers(heightmapPath, placement, seed, threads);
+
+    if (verify)
+        return verifyDeterminism(heightmapPath, placement, seed, threads < 2 ? 2 : threads);
+
+    if (verifyNoise)
+        return verifyNoiseGradient(seed);
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -239,6 +632,7 @@ int main() {
     glfwMakeContextCurrent(window);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
 
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
@@ -247,13 +641,15 @@ int main() {
         return -1;
     }
 
-    glEnable(GL_DEPTH_TEST);
+    glState().setEnabled(GL_DEPTH_TEST, true);
 
-    // Note to marker: Change directory according to your file's local location
-    Shader shader("C:/Users/USER/OneDrive - UNIVERSITAS INDONESIA/University of Queensland/Semester 1 2024/COSC3000/Assessment/Major Project/Project/MinecraftTerrain/shaders/vertex_shader.vs",
-        "C:/Users/USER/OneDrive - UNIVERSITAS INDONESIA/University of Queensland/Semester 1 2024/COSC3000/Assessment/Major Project/Project/MinecraftTerrain/shaders/fragment_shader.fs");
-    Shader simpleDepthShader("C:/Users/USER/OneDrive - UNIVERSITAS INDONESIA/University of Queensland/Semester 1 2024/COSC3000/Assessment/Major Project/Project/MinecraftTerrain/shaders/simple_depth_shader.vs",
-        "C:/Users/USER/OneDrive - UNIVERSITAS INDONESIA/University of Queensland/Semester 1 2024/COSC3000/Assessment/Major Project/Project/MinecraftTerrain/shaders/simple_depth_shader.fs");
+    // The shaders that draw chunk quads share the quad pulling and frame uniforms
+    std::string quadCommon = RESOURCE_DIR + "shaders/quad_common.glsl";
+    Shader shader((RESOURCE_DIR + "shaders/vertex_shader.vs").c_str(), (RESOURCE_DIR + "shaders/fragment_shader.fs").c_str(), quadCommon.c_str());
+    Shader simpleDepthShader((RESOURCE_DIR + "shaders/simple_depth_shader.vs").c_str(), (RESOURCE_DIR + "shaders/simple_depth_shader.fs").c_str(), quadCommon.c_str());
+    Shader sunShader((RESOURCE_DIR + "shaders/sun_shader.vs").c_str(), (RESOURCE_DIR + "shaders/sun_shader.fs").c_str());
+    Shader horizonShader((RESOURCE_DIR + "shaders/horizon_shader.vs").c_str(), (RESOURCE_DIR + "shaders/horizon_shader.fs").c_str());
+    Shader depthPrepassShader((RESOURCE_DIR + "shaders/depth_prepass_shader.vs").c_str(), (RESOURCE_DIR + "shaders/simple_depth_shader.fs").c_str(), quadCommon.c_str());
 
 
     unsigned int depthMapFBO;
@@ -261,20 +657,24 @@ int main() {
 
     unsigned int depthMap;
     glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
+    glState().bindTexture(0, GL_TEXTURE_2D, depthMap);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Lookups compare against the stored depth and blend the results of the 2x2 texels around
+    // them, which is a 4-sample PCF for the price of one fetch
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
     float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
     glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+    glState().bindFramebuffer(depthMapFBO);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState().bindFramebuffer(0);
 
     float vertices[] = {
         // positions          // normals           // texture coords
@@ -329,33 +729,12 @@ int main() {
          -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f
     };
 
-    unsigned int VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Normal attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Texture coordinate attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
     // create VAO for sun
     unsigned int sunVBO, sunVAO;
     glGenVertexArrays(1, &sunVAO);
     glGenBuffers(1, &sunVBO);
-    glBindVertexArray(sunVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, sunVBO);
+    glState().bindVertexArray(sunVAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, sunVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     // Position attribute for sun
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
@@ -367,37 +746,91 @@ int main() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    // Note to marker: Change directory according to your file's local location
-    // load and create textures 
-    unsigned int sandTexture = loadTexture("C:/Users/USER/OneDrive - UNIVERSITAS INDONESIA/University of Queensland/Semester 1 2024/COSC3000/Assessment/Major Project/Project/MinecraftTerrain/textures/sand.jpg");
-    unsigned int topTexture = loadTexture("C:/Users/USER/OneDrive - UNIVERSITAS INDONESIA/University of Queensland/Semester 1 2024/COSC3000/Assessment/Major Project/Project/MinecraftTerrain/textures/grassTop.jpg");
-    unsigned int sideTexture = loadTexture("C:/Users/USER/OneDrive - UNIVERSITAS INDONESIA/University of Queensland/Semester 1 2024/COSC3000/Assessment/Major Project/Project/MinecraftTerrain/textures/grassSide.jpg");
-    unsigned int bottomTexture = loadTexture("C:/Users/USER/OneDrive - UNIVERSITAS INDONESIA/University of Queensland/Semester 1 2024/COSC3000/Assessment/Major Project/Project/MinecraftTerrain/textures/dirt.jpg");
+    // One uniform buffer holds the values every shader shares for a frame
+    unsigned int frameUBO;
+    glGenBuffers(1, &frameUBO);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
+    glState().bindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, frameUBO);
+
+    // load and create textures, one array layer per TextureLayer
+    unsigned int blockTextures = loadTextureArray({
+        RESOURCE_DIR + "textures/sand.jpg",
+        RESOURCE_DIR + "textures/grassTop.jpg",
+        RESOURCE_DIR + "textures/grassSide.jpg",
+        RESOURCE_DIR + "textures/dirt.jpg"
+    });
 
     float cubeSpacing = 0.5f;
-    float cubeScale = 0.5f;
-    PerlinNoise perlin;
-    std::vector<std::vector<int>> terrainHeights(TERRAIN_SIZE, std::vector<int>(TERRAIN_SIZE));
-
-    for (int i = 0; i < TERRAIN_SIZE; i++) {
-        for (int j = 0; j < TERRAIN_SIZE; j++) {
-            float noiseValue = perlinNoise(i, j, perlin);
-            terrainHeights[i][j] = static_cast<int>(noiseValue * MAX_HEIGHT);
-        }
-    }
-
-    // Apply terrain smoothing
-    smoothTerrain(terrainHeights);
+    PerlinNoise perlin(seed);
+    ThreadPool threadPool(threads);
+    World world(WORLD_CHUNKS, WORLD_CHUNKS, seed);
+    std::unique_ptr<HeightSource> heightSource = createHeightSource(heightmapPath, placement, perlin, world);
+
+    // Generate the whole world at coarse detail first; chunks near the camera are
+    // refined to full detail (and decorated) over the following frames
+    world.generateCoarse(*heightSource, threadPool);
+    ChunkRenderer chunkRenderer(world, threadPool, cubeSpacing);
+    HorizonImpostor horizon(HORIZON_RESOLUTION);
+    DynamicResolution sceneTarget(SCR_WIDTH, SCR_HEIGHT, 1.0f / targetFps);
+    float lastArenaStats = 0.0f;
+    RenderQueue renderQueue;
+
+    // Fragments the opaque terrain pass shades, counted by alternating queries so the
+    // result read each frame is one the GPU finished a frame ago
+    unsigned int overdrawQueries[2];
+    glGenQueries(2, overdrawQueries);
+    int overdrawQuery = 0;
+    bool overdrawPending[2] = { false, false };
+    GLuint64 fragmentsShaded = 0;
 
     while (!glfwWindowShouldClose(window)) {
         // Per-frame time logic
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
+        // The first frame's time includes loading the world
+        if (lastFrame > 0.0f)
+            sceneTarget.update(deltaTime);
         lastFrame = currentFrame;
 
         // Input
         processInput(window);
 
+        // Levels of detail follow the projection, which changes with the zoom
+        chunkRenderer.setProjection(glm::radians(camera.Zoom), SCR_HEIGHT);
+
+        // Refine a few chunks around the camera each frame, a little beyond the full detail
+        // range so they are ready before they are drawn at full detail
+        float columnsVisible = chunkRenderer.lodDistance(0) / cubeSpacing;
+        glm::vec2 cameraColumn(camera.Position.x / cubeSpacing + TERRAIN_SIZE / 2, camera.Position.z / cubeSpacing + TERRAIN_SIZE / 2);
+        queueClickEdits(world, cubeSpacing);
+
+        world.applyEdits();
+        world.refine(*heightSource, threadPool, cameraColumn, glm::vec2(camera.Front.x, camera.Front.z),
+            columnsVisible + CHUNK_SIZE, static_cast<int>(threadPool.size()));
+        chunkRenderer.update(camera.Position);
+        if (currentFrame - lastArenaStats >= ARENA_STATS_INTERVAL) {
+            lastArenaStats = currentFrame;
+            printArenaStats("Opaque", chunkRenderer.getArenaStats(false));
+            printArenaStats("Translucent", chunkRenderer.getArenaStats(true));
+            const StreamBuffer& stream = chunkRenderer.getStreamBuffer();
+            std::cout << "Stream buffer (" << (stream.isPersistent() ? "persistent" : "unsynchronized") << "): "
+                << stream.getStalls() << " frames waited for the GPU" << std::endl;
+            std::cout << "Render queue: " << renderQueue.getLastItemCount() << " draws, "
+                << renderQueue.getUnsortedChanges().total() << " state changes as pushed, "
+                << renderQueue.getSortedChanges().total() << " sorted" << std::endl;
+            std::cout << "GL state: " << glState().getLastFrame().issued << " calls issued, "
+                << glState().getLastFrame().elided << " elided last frame" << std::endl;
+            std::cout << "Opaque terrain (depth prepass " << (depthPrepass ? "on" : "off") << "): "
+                << fragmentsShaded << " fragments shaded, "
+                << static_cast<double>(fragmentsShaded) / (sceneTarget.getWidth() * sceneTarget.getHeight()) << " per pixel" << std::endl;
+            std::cout << "Render scale: " << std::lround(sceneTarget.getScale() * 100.0f) << "% ("
+                << sceneTarget.getWidth() << "x" << sceneTarget.getHeight() << "), "
+                << sceneTarget.getAverageFrameTime() * 1000.0f << " ms per frame against "
+                << sceneTarget.getTargetFrameTime() * 1000.0f << " ms" << std::endl;
+        }
+
         // Calculate light position for rotating around the scene from top to bottom
         float radius = 64.0f;
         float angle = glfwGetTime() * glm::radians(1.0f); // Rotate 1 degrees per second
@@ -410,7 +843,6 @@ int main() {
 
         // Render
         glClearColor(skyColor.r, skyColor.g, skyColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Render depth of scene to texture (from light's perspective)
         glm::mat4 lightProjection, lightView;
@@ -420,118 +852,143 @@ int main() {
         lightView = glm::lookAt(lightPos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         lightSpaceMatrix = lightProjection * lightView;
 
-        simpleDepthShader.use();
-        simpleDepthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        for (int i = 0; i < TERRAIN_SIZE; i++) {
-            for (int j = 0; j < TERRAIN_SIZE; j++) {
-                for (int k = 0; k < terrainHeights[i][j]; k++) {
-                    glm::vec3 cubePos = glm::vec3(
-                        (i - TERRAIN_SIZE / 2) * cubeSpacing,
-                        k * cubeSpacing,
-                        (j - TERRAIN_SIZE / 2) * cubeSpacing
-                    );
-
-                    // Calculate the distance between the cube and the camera
-                    float distance = glm::length(camera.Position - cubePos);
-
-                    // Check if the cube is within the render distance
-                    if (distance <= RENDER_DISTANCE) {
-                        glm::mat4 model = glm::mat4(1.0f);
-                        model = glm::translate(model, cubePos);
-                        model = glm::scale(model, glm::vec3(cubeScale, cubeScale, cubeScale));
-                        simpleDepthShader.setMat4("model", model);
-                        glBindVertexArray(VAO);
-                        glDrawArrays(GL_TRIANGLES, 0, 36);
-                    }
-                }
-            }
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 2.0f * RENDER_DISTANCE);
+        glm::mat4 view = camera.GetViewMatrix();
+
+        // Everything the shaders share for the frame, in one buffer update
+        FrameUniforms frameUniforms;
+        frameUniforms.projection = projection;
+        frameUniforms.view = view;
+        frameUniforms.lightSpaceMatrix = lightSpaceMatrix;
+        frameUniforms.viewPos = camera.Position;
+        frameUniforms.lightPos = lightPos; // Use rotating light position
+        frameUniforms.sunPosition = lightPos;
+        frameUniforms.fogColor = skyColor;
+        frameUniforms.renderDistance = RENDER_DISTANCE;
+        writeFrameUniforms(frameUBO, frameUniforms);
+
+        shader.use();
+        glState().bindTexture(0, GL_TEXTURE_2D_ARRAY, blockTextures);
+        shader.setInt("blockTextures", 0);
+        glState().bindTexture(1, GL_TEXTURE_2D, depthMap);
+        shader.setInt("shadowMap", 1);
+        shader.setInt("shadowKernel", SHADOW_PRESETS[shadowPreset].kernel);
+        shader.setFloat("shadowRadius", SHADOW_PRESETS[shadowPreset].radius);
+
+        // Redraw the terrain beyond the near range into the horizon impostor, a face a frame,
+        // once the camera or the sun have moved enough to notice
+        if (horizon.needsRefresh(camera.Position, angle)) {
+            FrameUniforms faceUniforms = frameUniforms;
+            horizon.refresh(camera.Position, angle, 2.0f * RENDER_DISTANCE, [&](glm::vec3 eye, const glm::mat4& faceView, const glm::mat4& faceProjection) {
+                faceUniforms.projection = faceProjection;
+                faceUniforms.view = faceView;
+                // The whole block, so lighting and fog are seen from where the refresh started
+                faceUniforms.viewPos = eye;
+                writeFrameUniforms(frameUBO, faceUniforms);
+                chunkRenderer.draw(shader, eye, RENDER_DISTANCE, IMPOSTOR_DISTANCE);
+
+                // Keep the impostor opaque wherever there is water in front of terrain
+                glState().setEnabled(GL_BLEND, true);
+                glState().blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+                glState().depthMask(false);
+                chunkRenderer.drawTranslucent(shader, eye, RENDER_DISTANCE, IMPOSTOR_DISTANCE);
+                glState().depthMask(true);
+                glState().setEnabled(GL_BLEND, false);
+            });
+            writeFrameUniforms(frameUBO, frameUniforms);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        // Render scene as normal using the generated depth/shadow map  
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        // The scene goes to the offscreen target at the current render scale; the window
+        // only ever gets the stretched result
+        sceneTarget.bind();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        shader.use();
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
-        shader.setVec3("viewPos", camera.Position);
-        shader.setVec3("lightPos", lightPos); // Use rotating light position
-        shader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-        shader.setFloat("renderDistance", RENDER_DISTANCE);
-        shader.setVec3("sunPosition", lightPos);
-        shader.setVec3("fogColor", skyColor);
-
-        // Render the terrain
-        for (int i = 0; i < TERRAIN_SIZE; i++) {
-            for (int j = 0; j < TERRAIN_SIZE; j++) {
-                for (int k = 0; k < terrainHeights[i][j]; k++) {
-                    glm::vec3 cubePos = glm::vec3(
-                        (i - TERRAIN_SIZE / 2) * cubeSpacing,
-                        k * cubeSpacing,
-                        (j - TERRAIN_SIZE / 2) * cubeSpacing
-                    );
-
-                    // Calculate the distance between the cube and the camera
-                    float distance = glm::length(camera.Position - cubePos);
-                    if (distance <= RENDER_DISTANCE) {
-                        // Render the block
-
-                        glm::mat4 model = glm::mat4(1.0f);
-                        model = glm::translate(model, cubePos);
-                        model = glm::scale(model, glm::vec3(cubeScale, cubeScale, cubeScale));
-                        shader.setMat4("model", model);
-
-                        if (k < 7) {
-                            glActiveTexture(GL_TEXTURE0);
-                            glBindTexture(GL_TEXTURE_2D, sandTexture);
-                            shader.setInt("diffuseTexture", 0);
-                            shader.setInt("topTexture", 0);
-                            shader.setInt("sideTexture", 0);
-                            shader.setInt("bottomTexture", 0);
-                        }
-                        else {
-                            glActiveTexture(GL_TEXTURE2);
-                            glBindTexture(GL_TEXTURE_2D, topTexture);
-                            glActiveTexture(GL_TEXTURE3);
-                            glBindTexture(GL_TEXTURE_2D, sideTexture);
-                            glActiveTexture(GL_TEXTURE4);
-                            glBindTexture(GL_TEXTURE_2D, bottomTexture);
-                            shader.setInt("topTexture", 2);
-                            shader.setInt("sideTexture", 3);
-                            shader.setInt("bottomTexture", 4);
-                        }
-
-                        glBindVertexArray(VAO);
-                        glDrawArrays(GL_TRIANGLES, 0, 36);
-                    }
+        // Every draw of the frame goes through the queue, which puts them in pass order
+        // and groups them by state
+        float sunDistance = glm::length(lightPos - camera.Position);
+        renderQueue.push({ makeSortKey(PASS_SHADOW, simpleDepthShader.ID, 0, 0.0f, RENDER_DISTANCE),
+            simpleDepthShader.ID, 0, chunkRenderer.getVertexArray(), [&] {
+                // Depth of the scene from the light's perspective
+                simpleDepthShader.use();
+                glState().viewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+                glState().bindFramebuffer(depthMapFBO);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                chunkRenderer.draw(simpleDepthShader, camera.Position, SHADOW_DISTANCE);
+                sceneTarget.bind();
+            } });
+        // The far terrain as a background layer, only where nothing nearer has been drawn
+        renderQueue.push({ makeSortKey(PASS_BACKGROUND, horizonShader.ID, horizon.getTexture(), RENDER_DISTANCE, RENDER_DISTANCE),
+            horizonShader.ID, horizon.getTexture(), horizon.getVertexArray(), [&] {
+                horizon.draw(horizonShader, view, projection);
+            } });
+        // Depth only, so the shading pass below can skip every fragment that ends up hidden
+        if (depthPrepass) {
+            renderQueue.push({ makeSortKey(PASS_DEPTH_PREPASS, depthPrepassShader.ID, 0, 0.0f, RENDER_DISTANCE),
+                depthPrepassShader.ID, 0, chunkRenderer.getVertexArray(), [&] {
+                    depthPrepassShader.use();
+                    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                    chunkRenderer.draw(depthPrepassShader, camera.Position, IMPOSTOR_DISTANCE);
+                    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                } });
+        }
+        renderQueue.push({ makeSortKey(PASS_OPAQUE, shader.ID, blockTextures, 0.0f, RENDER_DISTANCE),
+            shader.ID, blockTextures, chunkRenderer.getVertexArray(), [&] {
+                shader.use();
+                if (depthPrepass) {
+                    glState().depthFunc(GL_EQUAL);
+                    glState().depthMask(false);
                 }
+                glBeginQuery(GL_SAMPLES_PASSED, overdrawQueries[overdrawQuery]);
+                chunkRenderer.draw(shader, camera.Position, IMPOSTOR_DISTANCE);
+                glEndQuery(GL_SAMPLES_PASSED);
+                overdrawPending[overdrawQuery] = true;
+                glState().depthFunc(GL_LESS);
+                glState().depthMask(true);
+            } });
+        renderQueue.push({ makeSortKey(PASS_OPAQUE, sunShader.ID, 0, sunDistance, RENDER_DISTANCE),
+            sunShader.ID, 0, sunVAO, [&] {
+                renderSun(sunShader, sunVAO, lightPos);
+            } });
+        // Water and glass last, blended over everything opaque. They don't write depth, so
+        // faces behind them still show; both are sorted back to front instead.
+        renderQueue.push({ makeSortKey(PASS_TRANSLUCENT, shader.ID, blockTextures, 0.0f, RENDER_DISTANCE),
+            shader.ID, blockTextures, chunkRenderer.getVertexArray(), [&] {
+                shader.use();
+                glState().setEnabled(GL_BLEND, true);
+                glState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glState().depthMask(false);
+                chunkRenderer.drawTranslucent(shader, camera.Position, IMPOSTOR_DISTANCE);
+                glState().depthMask(true);
+                glState().setEnabled(GL_BLEND, false);
+            } });
+        renderQueue.execute();
+        sceneTarget.present();
+
+        // Read the count of the previous frame, if the GPU has it ready
+        overdrawQuery = 1 - overdrawQuery;
+        if (overdrawPending[overdrawQuery]) {
+            GLint available = 0;
+            glGetQueryObjectiv(overdrawQueries[overdrawQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                glGetQueryObjectui64v(overdrawQueries[overdrawQuery], GL_QUERY_RESULT, &fragmentsShaded);
+                overdrawPending[overdrawQuery] = false;
             }
         }
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        shader.setInt("shadowMap", 1);
-
-        // Render the sun at its current position
-        renderSun(shader, sunVAO, lightPos, view, projection);
-
         // Swap buffers and poll IO events
+        glState().endFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
     // Clean up
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
     glDeleteVertexArrays(1, &sunVAO);
     glDeleteBuffers(1, &sunVBO);
+    glDeleteBuffers(1, &frameUBO);
+    glDeleteQueries(2, overdrawQueries);
+    glDeleteTextures(1, &blockTextures);
+    glDeleteTextures(1, &depthMap);
+    glDeleteFramebuffers(1, &depthMapFBO);
 
     // Terminate GLFW
     glfwTerminate();
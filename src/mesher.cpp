@@ -0,0 +1,573 @@
+#include "mesher.h"
+#include "world.h"
+#include <cstring>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Direction each face points in
+static const int FACE_NORMALS[6][3] = {
+    { 0, 0, -1 }, { 0, 0, 1 }, { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }
+};
+
+// Corner offsets of each face, counter-clockwise seen from outside the block. Must match
+// FACE_CORNERS in the vertex shaders.
+static const int FACE_CORNERS[6][4][3] = {
+    { { 0, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 } },
+    { { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 } },
+    { { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 } },
+    { { 1, 0, 0 }, { 1, 1, 0 }, { 1, 1, 1 }, { 1, 0, 1 } },
+    { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 }, { 0, 0, 1 } },
+    { { 0, 1, 0 }, { 0, 1, 1 }, { 1, 1, 1 }, { 1, 1, 0 } }
+};
+
+// Axis of each face's normal
+static int faceAxis(uint32_t face) {
+    return face / 2 == 0 ? 2 : (face / 2 == 1 ? 0 : 1);
+}
+
+static int countTrailingZeros(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+void copyPadded(const World& world, const Chunk& chunk, PaddedChunk& padded) {
+    std::memset(padded.blocks, BLOCK_AIR, sizeof(padded.blocks));
+
+    // Each padded column along z is made of up to three chunks: the apron cell on either
+    // side and the main span. Look each chunk up once per column rather than per block.
+    for (int px = 0; px < PADDED_SIZE; px++) {
+        int chunkX = chunk.chunkX + (px == 0 ? -1 : (px == PADDED_SIZE - 1 ? 1 : 0));
+        int localX = (px - 1 + CHUNK_SIZE) % CHUNK_SIZE;
+        const Chunk* before = world.getChunk(chunkX, chunk.chunkZ - 1);
+        const Chunk* middle = world.getChunk(chunkX, chunk.chunkZ);
+        const Chunk* after = world.getChunk(chunkX, chunk.chunkZ + 1);
+
+        for (int y = 0; y < CHUNK_HEIGHT; y++) {
+            uint8_t* row = padded.blocks[px][y + 1];
+            if (before != nullptr)
+                row[0] = before->blocks[localX][y][CHUNK_SIZE - 1];
+            if (middle != nullptr)
+                std::memcpy(row + 1, middle->blocks[localX][y], CHUNK_SIZE);
+            if (after != nullptr)
+                row[PADDED_SIZE - 1] = after->blocks[localX][y][0];
+        }
+    }
+}
+
+void copySnapshot(const World& world, const Chunk& chunk, int factor, ChunkSnapshot& snapshot) {
+    std::memset(snapshot.blocks, BLOCK_AIR, sizeof(snapshot.blocks));
+    for (int x = -factor; x < CHUNK_SIZE + factor; x++) {
+        int worldX = chunk.chunkX * CHUNK_SIZE + x;
+        if (worldX < 0 || worldX >= world.getSizeX())
+            continue;
+
+        // A row along z spans up to three chunks: the apron on either side and the chunk
+        for (int side = -1; side <= 1; side++) {
+            const Chunk* source = world.getChunk(worldX / CHUNK_SIZE, chunk.chunkZ + side);
+            if (source == nullptr)
+                continue;
+            int first = side < 0 ? CHUNK_SIZE - factor : 0;
+            int count = side == 0 ? CHUNK_SIZE : factor;
+            int target = MAX_CELL_BLOCKS + side * CHUNK_SIZE + first;
+            for (int y = 0; y < CHUNK_HEIGHT; y++)
+                std::memcpy(&snapshot.blocks[x + MAX_CELL_BLOCKS][y][target], &source->blocks[worldX % CHUNK_SIZE][y][first], count);
+        }
+    }
+}
+
+void downsample(const ChunkSnapshot& snapshot, int factor, PaddedChunk& cells) {
+    std::memset(cells.blocks, BLOCK_AIR, sizeof(cells.blocks));
+    int size = CHUNK_SIZE / factor;
+    int height = CHUNK_HEIGHT / factor;
+    int cellVolume = factor * factor * factor;
+
+    const uint8_t* columns[MAX_CELL_BLOCKS * MAX_CELL_BLOCKS];
+    for (int cx = -1; cx <= size; cx++) {
+        for (int cz = -1; cz <= size; cz++) {
+            // The block columns under this coarse column
+            int columnCount = 0;
+            for (int bx = 0; bx < factor; bx++) {
+                for (int bz = 0; bz < factor; bz++)
+                    columns[columnCount++] = &snapshot.blocks[cx * factor + bx + MAX_CELL_BLOCKS][0][cz * factor + bz + MAX_CELL_BLOCKS];
+            }
+
+            for (int cy = 0; cy < height; cy++) {
+                // Top down, so the first block found is the highest
+                int filled = 0;
+                uint8_t top = BLOCK_AIR;
+                for (int y = (cy + 1) * factor - 1; y >= cy * factor; y--) {
+                    for (int i = 0; i < columnCount; i++) {
+                        uint8_t block = columns[i][y * SNAPSHOT_SIZE];
+                        filled += block != BLOCK_AIR;
+                        if (top == BLOCK_AIR)
+                            top = block;
+                    }
+                }
+                if (2 * filled >= cellVolume)
+                    cells.blocks[cx + 1][cy + 1][cz + 1] = top;
+            }
+        }
+    }
+}
+
+// Classic voxel corner occlusion: count the two edge neighbours and the diagonal
+// neighbour of the corner in the layer of air in front of the face. Two solid edges
+// hide the diagonal block completely, so that case is always fully occluded.
+// solid(x, y, z) tells whether a chunk-local position holds a block.
+template <typename Solid>
+static uint32_t cornerOcclusion(const Solid& solid, int x, int y, int z, uint32_t face, int corner) {
+    // The cell in front of the face, and a unit step towards the corner along each of
+    // the two axes spanning the face
+    int front[3] = { x + FACE_NORMALS[face][0], y + FACE_NORMALS[face][1], z + FACE_NORMALS[face][2] };
+    int axis = faceAxis(face);
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    int stepU[3] = { 0, 0, 0 };
+    int stepV[3] = { 0, 0, 0 };
+    stepU[u] = FACE_CORNERS[face][corner][u] ? 1 : -1;
+    stepV[v] = FACE_CORNERS[face][corner][v] ? 1 : -1;
+
+    bool side1 = solid(front[0] + stepU[0], front[1] + stepU[1], front[2] + stepU[2]);
+    bool side2 = solid(front[0] + stepV[0], front[1] + stepV[1], front[2] + stepV[2]);
+    if (side1 && side2)
+        return 3;
+    bool diagonal = solid(front[0] + stepU[0] + stepV[0], front[1] + stepU[1] + stepV[1], front[2] + stepU[2] + stepV[2]);
+    return side1 + side2 + diagonal;
+}
+
+// Occlusion of all four corners packed 2 bits each, and whether the quad should be split
+// along its other diagonal
+template <typename Solid>
+static uint32_t faceOcclusion(const Solid& solid, int x, int y, int z, uint32_t face, uint32_t& flip) {
+    uint32_t occlusion[4];
+    uint32_t ao = 0;
+    for (int corner = 0; corner < 4; corner++) {
+        occlusion[corner] = cornerOcclusion(solid, x, y, z, face, corner);
+        ao |= occlusion[corner] << (2 * corner);
+    }
+
+    // Split along the diagonal whose corners are less occluded, otherwise the
+    // interpolated shading depends on how the quad happens to be triangulated
+    flip = occlusion[0] + occlusion[2] > occlusion[1] + occlusion[3] ? 1 : 0;
+    return ao;
+}
+
+void meshChunk(const PaddedChunk& chunk, std::vector<uint32_t>& faces) {
+    faces.clear();
+    auto solid = [&](int x, int y, int z) { return isOpaque(chunk.blocks[x + 1][y + 1][z + 1]); };
+
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int y = 0; y < CHUNK_HEIGHT; y++) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                uint8_t block = chunk.blocks[x + 1][y + 1][z + 1];
+                if (!isOpaque(block))
+                    continue;
+
+                for (uint32_t face = 0; face < 6; face++) {
+                    // Nothing is ever seen from below the world
+                    int ny = y + FACE_NORMALS[face][1];
+                    if (ny < 0)
+                        continue;
+                    if (solid(x + FACE_NORMALS[face][0], ny, z + FACE_NORMALS[face][2]))
+                        continue;
+
+                    uint32_t flip;
+                    uint32_t ao = faceOcclusion(solid, x, y, z, face, flip);
+                    faces.push_back(packFace(x, y, z, face, block, ao, flip));
+                    faces.push_back(packFaceSize(1, 1));
+                }
+            }
+        }
+    }
+}
+
+int appendSkirts(const PaddedChunk& cells, int size, std::vector<uint32_t>& faces) {
+    size_t start = faces.size();
+    for (uint32_t face = FACE_FRONT; face <= FACE_RIGHT; face++) {
+        for (int along = 0; along < size; along++) {
+            // The border cells facing out through this side, and their apron neighbours
+            int x = face == FACE_LEFT ? 0 : (face == FACE_RIGHT ? size - 1 : along);
+            int z = face == FACE_FRONT ? 0 : (face == FACE_BACK ? size - 1 : along);
+            const uint8_t (&inside)[PADDED_SIZE][PADDED_SIZE] = cells.blocks[x + 1];
+            const uint8_t (&outside)[PADDED_SIZE][PADDED_SIZE] = cells.blocks[x + 1 + FACE_NORMALS[face][0]];
+            int outsideZ = z + 1 + FACE_NORMALS[face][2];
+
+            // Merge vertical runs of the same block into one quad. Height is the quad's
+            // width on the x faces and its height on the z faces.
+            for (int y = 0; y < size;) {
+                uint8_t block = inside[y + 1][z + 1];
+                if (!isOpaque(block) || !isOpaque(outside[y + 1][outsideZ])) {
+                    y++;
+                    continue;
+                }
+                int run = 1;
+                while (y + run < size && inside[y + run + 1][z + 1] == block && isOpaque(outside[y + run + 1][outsideZ]))
+                    run++;
+                bool xFace = face == FACE_LEFT || face == FACE_RIGHT;
+                faces.push_back(packFace(x, y, z, face, block, 0, 0));
+                faces.push_back(xFace ? packFaceSize(run, 1) : packFaceSize(1, run));
+                y += run;
+            }
+        }
+    }
+    return static_cast<int>((faces.size() - start) / FACE_RECORD_WORDS);
+}
+
+// The greedy mesher works on one axis at a time. For a normal along axis n, positions
+// within a slice use u = (n + 1) % 3 and v = (n + 2) % 3, matching the quad size layout.
+// The chunk must be a cube for the bitplanes to line up on every axis.
+static_assert(CHUNK_SIZE == 32 && CHUNK_HEIGHT == 32, "greedy mesher assumes 32^3 chunks");
+
+// Occupancy of a chunk and a one block border as bit rows along z, the axis that is
+// contiguous in the padded copy: rows[x + 1][y + 1] has bit z + 1 set when the block at
+// (x, y, z) is opaque. Every face direction is found from these rows, so they are never
+// transposed into columns along the other axes.
+struct OccupancyRows {
+    uint64_t rows[PADDED_SIZE][PADDED_SIZE];
+};
+
+// Visible faces of one direction, sliced along the normal: bit b of rows[slice][r] is set
+// when the face at that position is visible, and keys[slice][r][b] holds its block type
+// and occlusion. Only faces with equal keys are merged; faces with uneven occlusion are
+// written out as they are found and never enter the rows. Normally r runs along v and b
+// along u; faces along x are stored the other way round, with b along z, so that their
+// rows come straight out of the occupancy rows.
+// Bit b of same[slice][r] is set when a visible face has the key of face b - 1 in its row,
+// and of above[slice][r] when it has the key of face b in row r - 1. They are worked out
+// as the faces are found, so merging is all bit operations. Bits and keys where no face is
+// visible are stale, but a merged run only ever reaches a face through visible ones.
+struct FacePlanes {
+    uint32_t slices; // Bit i set when slice i has any visible face
+    uint32_t rows[CHUNK_SIZE][CHUNK_SIZE];
+    uint32_t same[CHUNK_SIZE][CHUNK_SIZE];
+    uint32_t above[CHUNK_SIZE][CHUNK_SIZE];
+    uint16_t keys[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE];
+};
+
+// Face key layout: block type in bits 0-2, occlusion in bits 3-10, flip in bit 11. Bit 12
+// marks a face whose corners are occluded unevenly; its shading varies across the face,
+// so stretching it over a merged quad would smear it, and it is never merged.
+const uint16_t KEY_UNEVEN = 1 << 12;
+
+// Record of a single unmerged face with a key
+static void addFace(std::vector<uint32_t>& faces, int x, int y, int z, uint32_t face, uint16_t key) {
+    faces.push_back(packFace(x, y, z, face, key & 7, (key >> 3) & 255, (key >> 11) & 1));
+    faces.push_back(packFaceSize(1, 1));
+}
+
+// One bit per byte of an 8 byte group, set when the byte holds an opaque block
+static uint32_t opaqueBytes(const uint8_t* bytes) {
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    // Set the top bit of every non-zero byte, and separately of every translucent byte,
+    // without carries between bytes (block types are all below 128). Then gather the top
+    // bits of the opaque bytes into one byte, byte 0 in bit 0 (assumes a little-endian host)
+    const uint64_t low7 = 0x7F7F7F7F7F7F7F7Full;
+    const uint64_t ones = 0x0101010101010101ull;
+    uint64_t nonZero = ((word & low7) + low7) | word;
+    uint64_t translucent = word + (0x80 - BLOCK_WATER) * ones;
+    uint64_t high = ((nonZero & ~translucent) >> 7) & ones;
+    return static_cast<uint32_t>((high * 0x0102040810204080ull) >> 56);
+}
+
+static void buildOccupancy(const PaddedChunk& chunk, OccupancyRows& occupancy) {
+    for (int px = 0; px < PADDED_SIZE; px++) {
+        for (int py = 0; py < PADDED_SIZE; py++) {
+            const uint8_t* blocks = chunk.blocks[px][py];
+            uint64_t row = 0;
+            for (int pz = 0; pz + 8 <= PADDED_SIZE; pz += 8)
+                row |= static_cast<uint64_t>(opaqueBytes(blocks + pz)) << pz;
+            for (int pz = PADDED_SIZE / 8 * 8; pz < PADDED_SIZE; pz++)
+                row |= static_cast<uint64_t>(isOpaque(blocks[pz])) << pz;
+            occupancy.rows[px][py] = row;
+        }
+    }
+}
+
+// The eight positions around a face, as (u, v) offsets. Bit k of a neighbourhood index is
+// set when neighbour k is solid in the layer in front of the face.
+static const int NEIGHBOURS[8][2] = {
+    { -1, -1 }, { 0, -1 }, { 1, -1 }, { -1, 0 }, { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 }
+};
+
+// Face key bits other than the block type, for every face direction and neighbourhood
+struct OcclusionTable {
+    uint16_t keys[6][256];
+
+    OcclusionTable() {
+        for (uint32_t face = 0; face < 6; face++) {
+            int n = faceAxis(face);
+            int u = (n + 1) % 3;
+            int v = (n + 2) % 3;
+            for (int index = 0; index < 256; index++) {
+                // A block at the origin, so the layer in front of it starts at the normal
+                auto solid = [&](int x, int y, int z) {
+                    int offset[3] = { x - FACE_NORMALS[face][0], y - FACE_NORMALS[face][1], z - FACE_NORMALS[face][2] };
+                    int cell = (offset[u] + 1) + (offset[v] + 1) * 3;
+                    return cell != 4 && ((index >> (cell < 4 ? cell : cell - 1)) & 1) != 0;
+                };
+                uint32_t flip;
+                uint32_t ao = faceOcclusion(solid, 0, 0, 0, face, flip);
+                bool even = ao == (ao & 3) * 0x55;
+                keys[face][index] = static_cast<uint16_t>((ao << 3) | (flip << 11) | (even ? 0 : KEY_UNEVEN));
+            }
+        }
+    }
+};
+
+static const OcclusionTable OCCLUSION_TABLE;
+
+// Keys of the visible faces in row r of a slice whose bits run along z, for faces along x
+// or y at (x, y). around[k] has bit z set when neighbour k of the face at z is solid.
+// Faces with uneven occlusion go straight to the output; the rest are left to merge.
+static void keyRow(FacePlanes& planes, int slice, int r, const uint8_t* blocks, uint64_t visible,
+    const uint64_t (&around)[8], int x, int y, uint32_t face, std::vector<uint32_t>& faces) {
+    uint64_t occluded = 0;
+    for (uint64_t mask : around)
+        occluded |= mask;
+
+    const uint16_t* table = OCCLUSION_TABLE.keys[face];
+    uint16_t* keys = planes.keys[slice][r];
+    const uint16_t* previousKeys = planes.keys[slice][r > 0 ? r - 1 : 0];
+    uint32_t row = static_cast<uint32_t>(visible);
+    uint32_t same = 0;
+    uint32_t above = 0;
+    uint16_t last = 0xFFFF;
+    int lastZ = -2;
+    while (visible != 0) {
+        int z = countTrailingZeros(visible);
+        visible &= visible - 1;
+
+        int neighbourhood = 0;
+        if ((occluded >> z) & 1) {
+            for (int k = 0; k < 8; k++)
+                neighbourhood |= static_cast<int>((around[k] >> z) & 1) << k;
+        }
+        uint16_t key = static_cast<uint16_t>(blocks[z] | table[neighbourhood]);
+        if (key & KEY_UNEVEN) {
+            addFace(faces, x, y, z, face, key);
+            row &= ~(1u << z);
+        }
+        keys[z] = key;
+        same |= static_cast<uint32_t>(lastZ == z - 1 && last == key) << z;
+        above |= static_cast<uint32_t>(r > 0 && previousKeys[z] == key) << z;
+        last = key;
+        lastZ = z;
+    }
+    planes.rows[slice][r] = row;
+    planes.same[slice][r] = same;
+    planes.above[slice][r] = above;
+}
+
+// Merge the faces of one direction into as few quads as possible, row by row: take the
+// lowest set bit, extend it along the row while the keys match, then extend the whole run
+// across the following rows while they have the same bits and keys.
+static void mergeFaces(FacePlanes& planes, uint32_t face, bool transposed, std::vector<uint32_t>& faces) {
+    int n = faceAxis(face);
+    int u = (n + 1) % 3;
+    int v = (n + 2) % 3;
+    int bitAxis = transposed ? v : u;
+    int rowAxis = transposed ? u : v;
+
+    for (uint32_t slices = planes.slices; slices != 0; slices &= slices - 1) {
+        int slice = countTrailingZeros(slices);
+        uint32_t (&rows)[CHUNK_SIZE] = planes.rows[slice];
+        uint16_t (&keys)[CHUNK_SIZE][CHUNK_SIZE] = planes.keys[slice];
+        const uint32_t (&same)[CHUNK_SIZE] = planes.same[slice];
+        const uint32_t (&above)[CHUNK_SIZE] = planes.above[slice];
+
+        for (int row = 0; row < CHUNK_SIZE; row++) {
+            while (rows[row] != 0) {
+                int start = countTrailingZeros(rows[row]);
+                uint16_t key = keys[row][start];
+
+                uint64_t run = static_cast<uint64_t>(rows[row] & same[row]) >> (start + 1);
+                int length = 1 + countTrailingZeros(~run);
+                uint32_t mask = static_cast<uint32_t>(((1ull << length) - 1) << start);
+                int span = 1;
+                while (row + span < CHUNK_SIZE && (rows[row + span] & above[row + span] & mask) == mask)
+                    span++;
+                for (int i = row; i < row + span; i++)
+                    rows[i] &= ~mask;
+
+                int position[3];
+                position[n] = slice;
+                position[bitAxis] = start;
+                position[rowAxis] = row;
+                uint32_t block = key & 7;
+                uint32_t ao = (key >> 3) & 255;
+                uint32_t flip = (key >> 11) & 1;
+                faces.push_back(packFace(position[0], position[1], position[2], face, block, ao, flip));
+                faces.push_back(transposed ? packFaceSize(span, length) : packFaceSize(length, span));
+            }
+        }
+    }
+}
+
+void meshChunkGreedy(const PaddedChunk& chunk, std::vector<uint32_t>& faces, int size) {
+    faces.clear();
+
+    // Large enough to keep off the worker stacks, reused by every chunk this thread meshes
+    thread_local OccupancyRows occupancy;
+    thread_local FacePlanes planes;
+    buildOccupancy(chunk, occupancy);
+    const uint64_t (&rows)[PADDED_SIZE][PADDED_SIZE] = occupancy.rows;
+    uint64_t sizeMask = (1ull << size) - 1;
+
+    for (uint32_t face = 0; face < 6; face++) {
+        int n = faceAxis(face);
+        int step = face % 2 == 1 ? 1 : -1;
+
+        planes.slices = 0;
+        std::memset(planes.rows, 0, sizeof(planes.rows));
+
+        if (n != 2) {
+            // Faces along x or y: the occupancy row itself against the row one step along
+            // the normal gives a row of visible faces along z. Bit z of a row shifted right
+            // by 1 + d is the block at z + d.
+            for (int slice = 0; slice < size; slice++) {
+                // Nothing is ever seen from below the world
+                if (face == FACE_BOTTOM && slice == 0)
+                    continue;
+                for (int other = 0; other < size; other++) {
+                    int x = n == 0 ? slice : other;
+                    int y = n == 0 ? other : slice;
+                    int frontX = x + 1 + (n == 0 ? step : 0);
+                    int frontY = y + 1 + (n == 1 ? step : 0);
+                    uint64_t visible = ((rows[x + 1][y + 1] & ~rows[frontX][frontY]) >> 1) & sizeMask;
+                    if (visible == 0)
+                        continue;
+
+                    // For faces along y, u is z and v is x; for faces along x, u is y and
+                    // v is z
+                    uint64_t around[8];
+                    for (int k = 0; k < 8; k++) {
+                        int du = NEIGHBOURS[k][0];
+                        int dv = NEIGHBOURS[k][1];
+                        around[k] = n == 1 ? rows[frontX + dv][frontY] >> (1 + du) : rows[frontX][frontY + du] >> (1 + dv);
+                    }
+
+                    planes.slices |= 1u << slice;
+                    keyRow(planes, slice, other, &chunk.blocks[x + 1][y + 1][1], visible, around, x, y, face, faces);
+                }
+            }
+            mergeFaces(planes, face, n == 0, faces);
+            continue;
+        }
+
+        // Faces along z: each occupancy row is a column along the normal, so its visible
+        // faces fall in different slices and are scattered into them one by one
+        int frontShift = step > 0 ? 2 : 0;
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                uint64_t column = rows[x + 1][y + 1];
+                uint64_t visible = step > 0 ? column & ~(column >> 1) : column & ~(column << 1);
+                visible = (visible >> 1) & sizeMask;
+                if (visible == 0)
+                    continue;
+
+                uint64_t around[8];
+                for (int k = 0; k < 8; k++)
+                    around[k] = rows[x + 1 + NEIGHBOURS[k][0]][y + 1 + NEIGHBOURS[k][1]] >> frontShift;
+
+                const uint8_t* blocks = &chunk.blocks[x + 1][y + 1][1];
+                while (visible != 0) {
+                    int slice = countTrailingZeros(visible);
+                    visible &= visible - 1;
+
+                    int neighbourhood = 0;
+                    for (int k = 0; k < 8; k++)
+                        neighbourhood |= static_cast<int>((around[k] >> slice) & 1) << k;
+
+                    // Rows of a slice fill up in order, so the faces before and below this
+                    // one already have their keys
+                    uint16_t key = static_cast<uint16_t>(blocks[slice] | OCCLUSION_TABLE.keys[face][neighbourhood]);
+                    if (key & KEY_UNEVEN) {
+                        addFace(faces, x, y, slice, face, key);
+                        continue;
+                    }
+                    uint16_t (&keys)[CHUNK_SIZE][CHUNK_SIZE] = planes.keys[slice];
+                    uint32_t bit = 1u << x;
+                    uint32_t& row = planes.rows[slice][y];
+                    bool sameKey = x > 0 && (row & (bit >> 1)) != 0 && keys[y][x - 1] == key;
+                    bool aboveKey = y > 0 && keys[y - 1][x] == key;
+                    planes.slices |= 1u << slice;
+                    row |= bit;
+                    keys[y][x] = key;
+                    planes.same[slice][y] = (planes.same[slice][y] & ~bit) | (sameKey ? bit : 0);
+                    planes.above[slice][y] = (planes.above[slice][y] & ~bit) | (aboveKey ? bit : 0);
+                }
+            }
+        }
+        mergeFaces(planes, face, false, faces);
+    }
+}
+
+void meshTranslucent(const PaddedChunk& chunk, std::vector<uint32_t>& faces, int size) {
+    faces.clear();
+
+    for (int x = 0; x < size; x++) {
+        for (int y = 0; y < size; y++) {
+            const uint8_t* row = chunk.blocks[x + 1][y + 1] + 1;
+            // Most rows have no translucent blocks at all; the types are ordered so the
+            // largest one tells
+            if (*std::max_element(row, row + size) < BLOCK_WATER)
+                continue;
+
+            for (int z = 0; z < size; z++) {
+                uint8_t block = row[z];
+                if (!isTranslucent(block))
+                    continue;
+
+                for (uint32_t face = 0; face < 6; face++) {
+                    int ny = y + FACE_NORMALS[face][1];
+                    if (ny < 0)
+                        continue;
+                    // Hidden by opaque blocks, and by more of the same so a body of water
+                    // or a pane of glass only shows its outside
+                    uint8_t neighbour = chunk.blocks[x + 1 + FACE_NORMALS[face][0]][ny + 1][z + 1 + FACE_NORMALS[face][2]];
+                    if (isOpaque(neighbour) || neighbour == block)
+                        continue;
+
+                    faces.push_back(packFace(x, y, z, face, block, 0, 0));
+                    faces.push_back(packFaceSize(1, 1));
+                }
+            }
+        }
+    }
+}
+
+void sortBackToFront(std::vector<uint32_t>& faces, float eyeX, float eyeY, float eyeZ) {
+    size_t count = faces.size() / FACE_RECORD_WORDS;
+
+    // Sort (distance, index) pairs rather than the records themselves, then gather
+    thread_local std::vector<std::pair<float, uint32_t>> order;
+    thread_local std::vector<uint32_t> sorted;
+    order.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t record = faces[i * FACE_RECORD_WORDS];
+        uint32_t face = (record >> 15) & 7;
+        // Centre of the unit face: the block's centre pushed half a block along the normal
+        float dx = (record & 31) + 0.5f * (1 + FACE_NORMALS[face][0]) - eyeX;
+        float dy = ((record >> 5) & 31) + 0.5f * (1 + FACE_NORMALS[face][1]) - eyeY;
+        float dz = ((record >> 10) & 31) + 0.5f * (1 + FACE_NORMALS[face][2]) - eyeZ;
+        order[i] = { dx * dx + dy * dy + dz * dz, static_cast<uint32_t>(i) };
+    }
+    std::sort(order.begin(), order.end(), [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+        return a.first > b.first;
+    });
+
+    sorted.resize(faces.size());
+    for (size_t i = 0; i < count; i++) {
+        for (int word = 0; word < FACE_RECORD_WORDS; word++)
+            sorted[i * FACE_RECORD_WORDS + word] = faces[order[i].second * FACE_RECORD_WORDS + word];
+    }
+    faces.swap(sorted);
+}
@@ -0,0 +1,209 @@
+#include "quad_arena.h"
+#include "mesher.h"
+#include "gl_state.h"
+#include <algorithm>
+#include <iostream>
+
+static GLsizeiptr quadBytes(int quads) {
+    return static_cast<GLsizeiptr>(quads) * FACE_RECORD_WORDS * sizeof(uint32_t);
+}
+
+QuadArena::QuadArena(int initialQuads, int maxQuads) {
+    // Whole blocks only, so the arena itself is a block of the top class
+    topClass = sizeClassFor(std::min(initialQuads, maxQuads));
+    while (topClass > 0 && blockQuads(topClass) > maxQuads)
+        topClass--;
+    capacity = blockQuads(topClass);
+    initialCapacity = capacity;
+    this->maxQuads = maxQuads;
+
+    glGenBuffers(1, &buffer);
+    glState().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, quadBytes(capacity), nullptr, GL_DYNAMIC_DRAW);
+
+    glGenTextures(1, &texture);
+    glState().bindTexture(0, GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, buffer);
+
+    freeLists.resize(topClass + 1);
+    freeLists[topClass].insert(0);
+}
+
+QuadArena::~QuadArena() {
+    glState().deleteTexture(texture);
+    glState().deleteBuffer(buffer);
+}
+
+int QuadArena::sizeClassFor(int quads) {
+    int sizeClass = 0;
+    while (blockQuads(sizeClass) < quads)
+        sizeClass++;
+    return sizeClass;
+}
+
+int QuadArena::allocate(int quads) {
+    int sizeClass = sizeClassFor(std::max(quads, 1));
+    int first = takeBlock(sizeClass, capacity);
+    while (first < 0) {
+        if (capacity * 2 > maxQuads) {
+            std::cout << "Quad arena is full at " << capacity << " quads" << std::endl;
+            return -1;
+        }
+        // The new upper half is one free block, which merges with the old arena if that
+        // was empty
+        int oldCapacity = capacity;
+        resize(capacity * 2, capacity);
+        topClass++;
+        freeLists.resize(topClass + 1);
+        releaseBlock(oldCapacity, topClass - 1);
+        grows++;
+        first = takeBlock(sizeClass, capacity);
+    }
+
+    int handle;
+    if (freeHandles.empty()) {
+        handle = static_cast<int>(allocations.size());
+        allocations.emplace_back();
+    }
+    else {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+    allocations[handle] = { first, quads, sizeClass };
+    usedQuads += quads;
+    reservedQuads += blockQuads(sizeClass);
+    return handle;
+}
+
+void QuadArena::free(int handle) {
+    if (handle < 0)
+        return;
+    Allocation& allocation = allocations[handle];
+    releaseBlock(allocation.first, allocation.sizeClass);
+    usedQuads -= allocation.quads;
+    reservedQuads -= blockQuads(allocation.sizeClass);
+    allocation = Allocation();
+    freeHandles.push_back(handle);
+}
+
+void QuadArena::upload(int handle, const uint32_t* records, int quads) {
+    if (quads <= 0)
+        return;
+    glState().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, quadBytes(allocations[handle].first), quadBytes(quads), records);
+}
+
+void QuadArena::copy(int handle, unsigned int source, GLintptr sourceOffset, int quads) {
+    if (quads <= 0)
+        return;
+    glState().bindBuffer(GL_COPY_READ_BUFFER, source);
+    glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, quadBytes(allocations[handle].first),
+        quadBytes(quads));
+}
+
+int QuadArena::takeBlock(int sizeClass, int limit) {
+    for (int larger = sizeClass; larger <= topClass; larger++) {
+        std::set<int>& list = freeLists[larger];
+        if (list.empty() || *list.begin() >= limit)
+            continue;
+        int first = *list.begin();
+        list.erase(list.begin());
+        // Keep the lower half of each split and free the upper one
+        while (larger > sizeClass) {
+            larger--;
+            freeLists[larger].insert(first + blockQuads(larger));
+        }
+        return first;
+    }
+    return -1;
+}
+
+void QuadArena::releaseBlock(int first, int sizeClass) {
+    while (sizeClass < topClass) {
+        int buddy = first ^ blockQuads(sizeClass);
+        if (freeLists[sizeClass].erase(buddy) == 0)
+            break;
+        first = std::min(first, buddy);
+        sizeClass++;
+    }
+    freeLists[sizeClass].insert(first);
+}
+
+void QuadArena::compact(int maxMoves) {
+    // Moving blocks only pays off when it lets the buffer halve. Wait until a quarter or
+    // less is in use, so the next few meshes don't double it straight back.
+    if (capacity <= initialCapacity || reservedQuads * 4 > capacity)
+        return;
+
+    // Copies within one buffer are ordered with the draws around them, so a mesh can move
+    // while earlier draws still read it where it was
+    int half = capacity / 2;
+    glState().bindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    for (Allocation& allocation : allocations) {
+        if (maxMoves <= 0)
+            break;
+        if (allocation.first < half)
+            continue;
+        int first = takeBlock(allocation.sizeClass, half);
+        if (first < 0)
+            break;
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, quadBytes(allocation.first), quadBytes(first),
+            quadBytes(allocation.quads));
+        releaseBlock(allocation.first, allocation.sizeClass);
+        allocation.first = first;
+        movedQuads += allocation.quads;
+        maxMoves--;
+    }
+
+    // Once the arena is empty its halves have merged back into one free block of the
+    // whole buffer; split it again so the upper half can go
+    if (freeLists[topClass].count(0) > 0) {
+        freeLists[topClass].erase(0);
+        freeLists[topClass - 1].insert(0);
+        freeLists[topClass - 1].insert(half);
+    }
+
+    // Everything has left the upper half once it is a single free block
+    if (freeLists[topClass - 1].count(half) > 0) {
+        freeLists[topClass - 1].erase(half);
+        resize(half, half);
+        freeLists.pop_back();
+        topClass--;
+        shrinks++;
+    }
+}
+
+void QuadArena::resize(int newCapacity, int keep) {
+    unsigned int newBuffer;
+    glGenBuffers(1, &newBuffer);
+    glState().bindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, quadBytes(newCapacity), nullptr, GL_DYNAMIC_DRAW);
+    glState().bindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, quadBytes(keep));
+    glState().deleteBuffer(buffer);
+    buffer = newBuffer;
+    capacity = newCapacity;
+
+    glState().bindTexture(0, GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, buffer);
+}
+
+ArenaStats QuadArena::getStats() const {
+    ArenaStats stats;
+    stats.capacity = capacity;
+    stats.used = usedQuads;
+    stats.reserved = reservedQuads;
+    stats.allocations = static_cast<int>(allocations.size() - freeHandles.size());
+    for (int sizeClass = 0; sizeClass <= topClass; sizeClass++) {
+        int count = static_cast<int>(freeLists[sizeClass].size());
+        stats.free += count * blockQuads(sizeClass);
+        if (count > 0)
+            stats.largestFree = blockQuads(sizeClass);
+    }
+    stats.movedQuads = movedQuads;
+    stats.grows = grows;
+    stats.shrinks = shrinks;
+    return stats;
+}
@@ -0,0 +1,67 @@
+#include "render_queue.h"
+#include <algorithm>
+
+uint64_t makeSortKey(RenderPass pass, unsigned int program, unsigned int material, float depth, float maxDepth) {
+    float unit = maxDepth > 0.0f ? std::clamp(depth / maxDepth, 0.0f, 1.0f) : 0.0f;
+    uint64_t bucket = static_cast<uint64_t>(unit * (DEPTH_BUCKETS - 1));
+    uint64_t key = static_cast<uint64_t>(pass) << 56;
+    if (pass == PASS_TRANSLUCENT) {
+        bucket = (DEPTH_BUCKETS - 1) - bucket;
+        return key | (bucket << 40) | (static_cast<uint64_t>(program & 0xFFF) << 28) | (static_cast<uint64_t>(material & 0xFFF) << 16);
+    }
+    return key | (static_cast<uint64_t>(program & 0xFFF) << 44) | (static_cast<uint64_t>(material & 0xFFF) << 32) | (bucket << 16);
+}
+
+void RenderQueue::push(DrawItem item) {
+    items.push_back(std::move(item));
+}
+
+void RenderQueue::execute() {
+    unsortedChanges = countChanges(items);
+    radixSort();
+    sortedChanges = countChanges(items);
+    lastItemCount = static_cast<int>(items.size());
+
+    for (const DrawItem& item : items)
+        item.draw();
+    items.clear();
+}
+
+void RenderQueue::radixSort() {
+    if (items.size() < 2)
+        return;
+
+    uint64_t allSet = ~0ull;
+    uint64_t anySet = 0;
+    for (const DrawItem& item : items) {
+        allSet &= item.key;
+        anySet |= item.key;
+    }
+    uint64_t varying = allSet ^ anySet;
+
+    scratch.resize(items.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        if (((varying >> shift) & 0xFF) == 0)
+            continue;
+
+        size_t offsets[257] = {};
+        for (const DrawItem& item : items)
+            offsets[((item.key >> shift) & 0xFF) + 1]++;
+        for (int digit = 0; digit < 256; digit++)
+            offsets[digit + 1] += offsets[digit];
+        for (DrawItem& item : items)
+            scratch[offsets[(item.key >> shift) & 0xFF]++] = std::move(item);
+        items.swap(scratch);
+    }
+}
+
+StateChanges RenderQueue::countChanges(const std::vector<DrawItem>& items) {
+    // The first draw of a frame always sets everything, so it isn't counted
+    StateChanges changes;
+    for (size_t i = 1; i < items.size(); i++) {
+        changes.programs += items[i].program != items[i - 1].program;
+        changes.materials += items[i].material != items[i - 1].material;
+        changes.vertexArrays += items[i].vertexArray != items[i - 1].vertexArray;
+    }
+    return changes;
+}
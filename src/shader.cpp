@@ -1,7 +1,18 @@
 #include "shader.h"
+#include "frame_uniforms.h"
+#include "gl_state.h"
 #include <filesystem>
+#include <cstring>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+// Binding point of every uniform block a shader may declare
+static const struct {
+    const char* name;
+    unsigned int binding;
+} UNIFORM_BLOCK_BINDINGS[] = {
+    { "FrameUniforms", FRAME_UNIFORMS_BINDING }
+};
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* vertexHeaderPath) {
     // Print the current working directory
     std::cout << "Current path is " << std::filesystem::current_path() << '\n';
 
@@ -49,13 +60,15 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     catch (std::ifstream::failure& e) {
         std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
     }
+    std::string vertexHeader = vertexHeaderPath != nullptr ? readSource(vertexHeaderPath) : std::string();
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
     // Compile shaders
     unsigned int vertex, fragment;
-    // Vertex Shader
+    // Vertex Shader, as two source strings so compile errors give the line within each file
     vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
+    const char* vertexSources[2] = { vertexHeader.c_str(), vShaderCode };
+    glShaderSource(vertex, vertexHeaderPath != nullptr ? 2 : 1, vertexHeaderPath != nullptr ? vertexSources : &vShaderCode, NULL);
     glCompileShader(vertex);
     checkCompileErrors(vertex, "VERTEX");
     // Fragment Shader
@@ -69,13 +82,26 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     glAttachShader(ID, fragment);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
+    bindUniformBlocks();
     // Delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
 }
 
+std::string Shader::readSource(const char* path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open shader file: " << path << std::endl;
+        return std::string();
+    }
+    std::cout << "Loading shader header from: " << path << std::endl;
+    std::stringstream stream;
+    stream << file.rdbuf();
+    return stream.str();
+}
+
 void Shader::use() {
-    glUseProgram(ID);
+    glState().useProgram(ID);
 }
 
 void Shader::setBool(const std::string& name, bool value) const {
@@ -99,6 +125,24 @@ void Shader::setVec3(const std::string& name, const glm::vec3& value) const {
     glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
 }
 
+void Shader::bindUniformBlocks() {
+    int blockCount = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    for (int block = 0; block < blockCount; block++) {
+        char name[64];
+        glGetActiveUniformBlockName(ID, block, sizeof(name), NULL, name);
+        bool bound = false;
+        for (const auto& binding : UNIFORM_BLOCK_BINDINGS) {
+            if (std::strcmp(name, binding.name) == 0) {
+                glUniformBlockBinding(ID, block, binding.binding);
+                bound = true;
+            }
+        }
+        if (!bound)
+            std::cerr << "Uniform block " << name << " has no binding point" << std::endl;
+    }
+}
+
 void Shader::checkCompileErrors(unsigned int shader, std::string type) {
     int success;
     char infoLog[1024];
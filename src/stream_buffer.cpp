@@ -0,0 +1,77 @@
+#include "stream_buffer.h"
+#include "gl_state.h"
+#include <cstring>
+#include <iostream>
+
+StreamBuffer::StreamBuffer(size_t frameBytes) : frameBytes(frameBytes) {
+    GLsizeiptr size = static_cast<GLsizeiptr>(frameBytes * STREAM_FRAMES);
+    glGenBuffers(1, &buffer);
+    glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (GLAD_GL_VERSION_4_4) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+        if (mapped == nullptr)
+            std::cout << "Failed to map stream buffer persistently" << std::endl;
+    }
+    else {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (GLsync fence : fences) {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+    }
+    if (mapped != nullptr) {
+        glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    glState().deleteBuffer(buffer);
+}
+
+void StreamBuffer::nextFrame() {
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame = (frame + 1) % STREAM_FRAMES;
+    used = 0;
+
+    GLsync& fence = fences[frame];
+    if (fence == nullptr)
+        return;
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        stalls++;
+        // Flush so the fence is sure to be reached, then wait as long as it takes
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    if (status == GL_WAIT_FAILED)
+        std::cout << "Waiting for a stream buffer fence failed" << std::endl;
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+GLintptr StreamBuffer::write(const void* data, size_t bytes, size_t alignment) {
+    size_t start = (used + alignment - 1) / alignment * alignment;
+    if (start + bytes > frameBytes)
+        return -1;
+    used = start + bytes;
+
+    GLintptr offset = static_cast<GLintptr>(frame * frameBytes + start);
+    if (mapped != nullptr) {
+        std::memcpy(mapped + offset, data, bytes);
+        return offset;
+    }
+
+    // The fence in nextFrame() already waited for the GPU to be done with this region
+    glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    void* range = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, static_cast<GLsizeiptr>(bytes),
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (range == nullptr)
+        return -1;
+    std::memcpy(range, data, bytes);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    return offset;
+}
@@ -0,0 +1,161 @@
+#include "terrain.h"
+#include <vector>
+#include <algorithm>
+
+float perlinNoise(float x, float y, const PerlinNoise& perlin) {
+    float total = 0.0f;
+    float frequency = FREQUENCY;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;
+
+    for (int i = 0; i < OCTAVES; i++) {
+        total += perlin.noise(x * frequency, y * frequency) * amplitude;
+        maxValue += amplitude;
+        frequency *= 2.0f;
+        amplitude *= PERSISTENCE;
+    }
+
+    return total / maxValue;
+}
+
+float perlinNoise(float x, float y, const PerlinNoise& perlin, int octaves) {
+    float total = 0.0f;
+    float frequency = FREQUENCY;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;
+
+    for (int i = 0; i < OCTAVES; i++) {
+        // Noise is in [0, 1] with mean 0.5, so skipped octaves keep the overall level
+        total += (i < octaves ? perlin.noise(x * frequency, y * frequency) : 0.5f) * amplitude;
+        maxValue += amplitude;
+        frequency *= 2.0f;
+        amplitude *= PERSISTENCE;
+    }
+
+    return total / maxValue;
+}
+
+// fBm as above, also returning the analytic gradient of the result with respect to (x, y).
+// Costs one noise evaluation per octave, the same as the plain version.
+float perlinNoise(float x, float y, const PerlinNoise& perlin, glm::vec2& gradient) {
+    float total = 0.0f;
+    float frequency = FREQUENCY;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;
+    gradient = glm::vec2(0.0f);
+
+    for (int i = 0; i < OCTAVES; i++) {
+        double dx, dy;
+        total += perlin.noise(x * frequency, y * frequency, dx, dy) * amplitude;
+        // Chain rule: d/dx n(x * f) = f * n'(x * f)
+        gradient += glm::vec2(dx, dy) * (amplitude * frequency);
+        maxValue += amplitude;
+        frequency *= 2.0f;
+        amplitude *= PERSISTENCE;
+    }
+
+    gradient /= maxValue;
+    return total / maxValue;
+}
+
+void NoiseHeightSource::sampleHeights(int x0, int z0, int width, int depth, int* out, float* slopes) const {
+    for (int x = 0; x < width; x++) {
+        for (int z = 0; z < depth; z++) {
+            glm::vec2 gradient;
+            float noiseValue = perlinNoise(static_cast<float>(x0 + x), static_cast<float>(z0 + z), perlin, gradient);
+            out[x * depth + z] = static_cast<int>(noiseValue * MAX_HEIGHT);
+            slopes[x * depth + z] = glm::length(gradient) * MAX_HEIGHT;
+        }
+    }
+}
+
+float NoiseHeightSource::sampleCoarseHeight(int x, int z, int step) const {
+    // Each halving of the sample rate makes one more octave invisible
+    int octaves = OCTAVES;
+    for (int s = step; s > 1 && octaves > 1; s /= 2)
+        octaves--;
+    return perlinNoise(static_cast<float>(x), static_cast<float>(z), perlin, octaves) * MAX_HEIGHT;
+}
+
+// Fill the columns with blocks up to their height, and with water up to the water level.
+// Steep columns get stone where they would have grass.
+static void fillBlocks(Chunk& chunk, const bool (&steep)[CHUNK_SIZE][CHUNK_SIZE]) {
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        for (int j = 0; j < CHUNK_SIZE; j++) {
+            int height = std::min(chunk.heights[i][j], CHUNK_HEIGHT);
+            BlockType surface = steep[i][j] ? BLOCK_STONE : BLOCK_GRASS;
+            for (int k = 0; k < CHUNK_HEIGHT; k++) {
+                if (k >= height)
+                    chunk.blocks[i][k][j] = k < WATER_LEVEL ? BLOCK_WATER : BLOCK_AIR;
+                else
+                    chunk.blocks[i][k][j] = k < SAND_LEVEL ? BLOCK_SAND : surface;
+            }
+        }
+    }
+    chunk.meshDirty = true;
+}
+
+void generateChunk(Chunk& chunk, const HeightSource& source) {
+    const int padded = CHUNK_SIZE + 2;
+    std::vector<int> raw(padded * padded);
+    std::vector<float> slopes(padded * padded);
+    source.sampleHeights(chunk.chunkX * CHUNK_SIZE - 1, chunk.chunkZ * CHUNK_SIZE - 1, padded, padded, raw.data(), slopes.data());
+
+    // 3x3 box filter; the apron means border columns see their real neighbours
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        for (int j = 0; j < CHUNK_SIZE; j++) {
+            int sum = 0;
+            for (int x = 0; x <= 2; x++) {
+                for (int y = 0; y <= 2; y++) {
+                    sum += raw[(i + x) * padded + (j + y)];
+                }
+            }
+            chunk.heights[i][j] = sum / 9;
+        }
+    }
+
+    // The slope of the column itself, before smoothing
+    bool steep[CHUNK_SIZE][CHUNK_SIZE];
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        for (int j = 0; j < CHUNK_SIZE; j++)
+            steep[i][j] = slopes[(i + 1) * padded + (j + 1)] > STEEP_SLOPE;
+    }
+
+    fillBlocks(chunk, steep);
+    chunk.detail = 1;
+}
+
+void generateCoarseChunk(Chunk& chunk, const HeightSource& source, int step) {
+    const int samples = CHUNK_SIZE / step + 1;
+    std::vector<float> coarse(samples * samples);
+    for (int i = 0; i < samples; i++) {
+        for (int j = 0; j < samples; j++) {
+            coarse[i * samples + j] = source.sampleCoarseHeight(
+                chunk.chunkX * CHUNK_SIZE + i * step, chunk.chunkZ * CHUNK_SIZE + j * step, step);
+        }
+    }
+
+    // Slopes come from the interpolated surface, so they change only from cell to cell
+    bool steep[CHUNK_SIZE][CHUNK_SIZE];
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        int si = i / step;
+        float fx = static_cast<float>(i % step) / step;
+        for (int j = 0; j < CHUNK_SIZE; j++) {
+            int sj = j / step;
+            float fz = static_cast<float>(j % step) / step;
+            float h00 = coarse[si * samples + sj];
+            float h10 = coarse[(si + 1) * samples + sj];
+            float h01 = coarse[si * samples + sj + 1];
+            float h11 = coarse[(si + 1) * samples + sj + 1];
+            float near = h00 + fx * (h10 - h00);
+            float far = h01 + fx * (h11 - h01);
+            chunk.heights[i][j] = static_cast<int>(near + fz * (far - near));
+
+            glm::vec2 gradient(((1.0f - fz) * (h10 - h00) + fz * (h11 - h01)) / step, (far - near) / step);
+            steep[i][j] = glm::length(gradient) > STEEP_SLOPE;
+        }
+    }
+
+    fillBlocks(chunk, steep);
+    chunk.detail = step;
+}
@@ -0,0 +1,267 @@
+#include "world.h"
+#include "decoration.h"
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+World::World(int chunksX, int chunksZ, uint64_t seed) : seed(seed), chunksX(chunksX), chunksZ(chunksZ) {
+    chunks.resize(chunksX * chunksZ);
+    for (int cx = 0; cx < chunksX; cx++) {
+        for (int cz = 0; cz < chunksZ; cz++) {
+            std::unique_ptr<Chunk>& chunk = chunks[cx * chunksZ + cz];
+            chunk = std::make_unique<Chunk>();
+            chunk->chunkX = cx;
+            chunk->chunkZ = cz;
+        }
+    }
+}
+
+void World::generate(const HeightSource& source, ThreadPool& pool) {
+    auto start = std::chrono::steady_clock::now();
+    pool.parallelFor(static_cast<int>(chunks.size()), [&](int i) {
+        generateChunk(*chunks[i], source);
+        placeDecorationCandidates(*chunks[i], seed);
+    });
+
+    auto terrainDone = std::chrono::steady_clock::now();
+    pool.parallelFor(static_cast<int>(chunks.size()), [&](int i) {
+        decorateChunk(*chunks[i], *this);
+        chunks[i]->decorated = true;
+    });
+
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Generated " << chunks.size() << " chunks in "
+        << std::chrono::duration<double, std::milli>(end - start).count() << " ms (decoration "
+        << std::chrono::duration<double, std::milli>(end - terrainDone).count() << " ms)" << std::endl;
+}
+
+void World::generateCoarse(const HeightSource& source, ThreadPool& pool) {
+    auto start = std::chrono::steady_clock::now();
+    pool.parallelFor(static_cast<int>(chunks.size()), [&](int i) {
+        generateCoarseChunk(*chunks[i], source, COARSE_STEP);
+        chunks[i]->decorated = false;
+        // Candidates only depend on the seed, so neighbours can resolve against them early
+        placeDecorationCandidates(*chunks[i], seed);
+    });
+
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Generated " << chunks.size() << " coarse chunks in "
+        << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+}
+
+int World::refine(const HeightSource& source, ThreadPool& pool, glm::vec2 cameraColumn, glm::vec2 viewDirection,
+    float radius, int maxChunks) {
+    struct Candidate {
+        Chunk* chunk;
+        float score;
+    };
+    std::vector<Candidate> candidates;
+    float viewLength = glm::length(viewDirection);
+    glm::vec2 forward = viewLength > 0.0f ? viewDirection / viewLength : glm::vec2(0.0f);
+
+    for (const std::unique_ptr<Chunk>& chunk : chunks) {
+        if (chunk->detail == 1)
+            continue;
+        glm::vec2 center((chunk->chunkX + 0.5f) * CHUNK_SIZE, (chunk->chunkZ + 0.5f) * CHUNK_SIZE);
+        glm::vec2 offset = center - cameraColumn;
+        float distance = glm::length(offset);
+        if (distance > radius + CHUNK_SIZE * 0.71f)
+            continue;
+        // Chunks behind the camera count as twice as far away
+        bool behind = distance > CHUNK_SIZE && glm::dot(offset, forward) < 0.0f;
+        candidates.push_back({ chunk.get(), behind ? distance * 2.0f : distance });
+    }
+    if (candidates.empty())
+        return 0;
+
+    int count = std::min(maxChunks, static_cast<int>(candidates.size()));
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+        [](const Candidate& a, const Candidate& b) { return a.score < b.score; });
+
+    // On the urgent lane, ahead of the mesh and sort jobs queued by the renderer, so the
+    // render thread waits for these chunks and not for the streaming backlog
+    pool.parallelFor(count, [&](int i) {
+        generateChunk(*candidates[i].chunk, source);
+    }, true);
+
+    // Refined chunks may have completed the neighbourhood of chunks around them
+    std::vector<Chunk*> ready;
+    for (int i = 0; i < count; i++) {
+        const Chunk* refined = candidates[i].chunk;
+        for (int cx = refined->chunkX - 1; cx <= refined->chunkX + 1; cx++) {
+            for (int cz = refined->chunkZ - 1; cz <= refined->chunkZ + 1; cz++) {
+                Chunk* chunk = getChunk(cx, cz);
+                if (chunk != nullptr && !chunk->decorated && canDecorate(*chunk)
+                    && std::find(ready.begin(), ready.end(), chunk) == ready.end())
+                    ready.push_back(chunk);
+            }
+        }
+    }
+    pool.parallelFor(static_cast<int>(ready.size()), [&](int i) {
+        decorateChunk(*ready[i], *this);
+        ready[i]->decorated = true;
+    }, true);
+
+    for (int i = 0; i < count; i++)
+        markMeshDirty(candidates[i].chunk->chunkX, candidates[i].chunk->chunkZ);
+    for (Chunk* chunk : ready)
+        markMeshDirty(chunk->chunkX, chunk->chunkZ);
+
+    return count;
+}
+
+void World::markMeshDirty(int chunkX, int chunkZ) {
+    for (int cx = chunkX - 1; cx <= chunkX + 1; cx++) {
+        for (int cz = chunkZ - 1; cz <= chunkZ + 1; cz++) {
+            Chunk* chunk = getChunk(cx, cz);
+            if (chunk != nullptr)
+                chunk->meshDirty = true;
+        }
+    }
+}
+
+void World::queueEdit(int x, int y, int z, uint8_t block) {
+    pendingEdits.push_back({ x, y, z, block });
+}
+
+int World::applyEdits() {
+    int changed = 0;
+    for (const BlockEdit& edit : pendingEdits) {
+        if (edit.x < 0 || edit.z < 0 || edit.x >= getSizeX() || edit.z >= getSizeZ() || edit.y < 0 || edit.y >= CHUNK_HEIGHT)
+            continue;
+        int chunkX = edit.x / CHUNK_SIZE;
+        int chunkZ = edit.z / CHUNK_SIZE;
+        Chunk* chunk = getChunk(chunkX, chunkZ);
+        if (!chunk->decorated)
+            continue;
+
+        int localX = edit.x % CHUNK_SIZE;
+        int localZ = edit.z % CHUNK_SIZE;
+        uint8_t& block = chunk->blocks[localX][edit.y][localZ];
+        if (block == edit.block)
+            continue;
+        block = edit.block;
+        changed++;
+
+        // A block on a border shows in the neighbour's faces and corner occlusion, and a
+        // block on a corner in the diagonal neighbour's too
+        int stepX = localX == 0 ? -1 : (localX == CHUNK_SIZE - 1 ? 1 : 0);
+        int stepZ = localZ == 0 ? -1 : (localZ == CHUNK_SIZE - 1 ? 1 : 0);
+        for (int dx = 0; dx <= 1; dx++) {
+            for (int dz = 0; dz <= 1; dz++) {
+                if ((dx == 1 && stepX == 0) || (dz == 1 && stepZ == 0))
+                    continue;
+                Chunk* affected = getChunk(chunkX + dx * stepX, chunkZ + dz * stepZ);
+                if (affected != nullptr) {
+                    affected->meshDirty = true;
+                    affected->editDirty = true;
+                }
+            }
+        }
+    }
+    pendingEdits.clear();
+    return changed;
+}
+
+bool World::raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, glm::ivec3& hit, glm::ivec3& before) const {
+    // Amanatides-Woo traversal: step into whichever neighbouring block's boundary the ray
+    // crosses first
+    glm::ivec3 cell = glm::ivec3(glm::floor(origin));
+    glm::ivec3 step;
+    glm::vec3 tMax;
+    glm::vec3 tDelta;
+    for (int axis = 0; axis < 3; axis++) {
+        if (direction[axis] > 0.0f) {
+            step[axis] = 1;
+            tDelta[axis] = 1.0f / direction[axis];
+            tMax[axis] = (cell[axis] + 1 - origin[axis]) * tDelta[axis];
+        }
+        else if (direction[axis] < 0.0f) {
+            step[axis] = -1;
+            tDelta[axis] = -1.0f / direction[axis];
+            tMax[axis] = (origin[axis] - cell[axis]) * tDelta[axis];
+        }
+        else {
+            step[axis] = 0;
+            tDelta[axis] = 0.0f;
+            tMax[axis] = std::numeric_limits<float>::infinity();
+        }
+    }
+
+    float t = 0.0f;
+    before = cell;
+    while (t <= maxDistance) {
+        // Water can't be picked, so blocks under it can be edited
+        uint8_t block = getBlock(cell.x, cell.y, cell.z);
+        if (block != BLOCK_AIR && block != BLOCK_WATER) {
+            hit = cell;
+            return true;
+        }
+        before = cell;
+        int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+        t = tMax[axis];
+        tMax[axis] += tDelta[axis];
+        cell[axis] += step[axis];
+    }
+    return false;
+}
+
+bool World::canDecorate(const Chunk& chunk) const {
+    for (int cx = chunk.chunkX - 1; cx <= chunk.chunkX + 1; cx++) {
+        for (int cz = chunk.chunkZ - 1; cz <= chunk.chunkZ + 1; cz++) {
+            const Chunk* neighbour = getChunk(cx, cz);
+            if (neighbour != nullptr && neighbour->detail != 1)
+                return false;
+        }
+    }
+    return true;
+}
+
+Chunk* World::getChunk(int chunkX, int chunkZ) {
+    if (chunkX < 0 || chunkX >= chunksX || chunkZ < 0 || chunkZ >= chunksZ)
+        return nullptr;
+    return chunks[chunkX * chunksZ + chunkZ].get();
+}
+
+const Chunk* World::getChunk(int chunkX, int chunkZ) const {
+    if (chunkX < 0 || chunkX >= chunksX || chunkZ < 0 || chunkZ >= chunksZ)
+        return nullptr;
+    return chunks[chunkX * chunksZ + chunkZ].get();
+}
+
+int World::getHeight(int x, int z) const {
+    if (x < 0 || z < 0)
+        return 0;
+    const Chunk* chunk = getChunk(x / CHUNK_SIZE, z / CHUNK_SIZE);
+    if (chunk == nullptr)
+        return 0;
+    return chunk->heights[x % CHUNK_SIZE][z % CHUNK_SIZE];
+}
+
+uint8_t World::getBlock(int x, int y, int z) const {
+    if (x < 0 || z < 0 || y < 0 || y >= CHUNK_HEIGHT)
+        return BLOCK_AIR;
+    const Chunk* chunk = getChunk(x / CHUNK_SIZE, z / CHUNK_SIZE);
+    if (chunk == nullptr)
+        return BLOCK_AIR;
+    return chunk->blocks[x % CHUNK_SIZE][y][z % CHUNK_SIZE];
+}
+
+uint64_t World::hashChunk(int chunkX, int chunkZ) const {
+    const Chunk* chunk = getChunk(chunkX, chunkZ);
+    if (chunk == nullptr)
+        return 0;
+
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ull;
+        }
+    };
+    mix(chunk->heights, sizeof(chunk->heights));
+    mix(chunk->blocks, sizeof(chunk->blocks));
+    return hash;
+}